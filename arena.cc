@@ -0,0 +1,68 @@
+/**
+ * file: arena.cc
+ * 
+ * authors:	Cem Keske
+ * 			Emre Yazici
+ */
+#include "arena.h"
+#include <algorithm>
+
+// every allocation is aligned for any fundamental type
+static constexpr size_t alignment(alignof(std::max_align_t));
+
+static size_t aligned(size_t size) {
+	return (size + alignment - 1) / alignment * alignment;
+}
+
+/// ===== FRAME ARENA ===== ///
+
+
+// ===== Constructor =====
+
+Frame_Arena::Frame_Arena(size_t capacity) : capacity_(0), used_(0), 
+											overflow_size_(0) {
+	reserve(capacity);
+}
+
+// ===== Accessors =====
+
+size_t Frame_Arena::capacity() const {return capacity_;}
+
+size_t Frame_Arena::used() const {return used_ + overflow_size_;}
+
+// ===== Methods =====
+
+/**
+ * Enlarges the buffer. Must not be called while allocations are in use.
+ */
+void Frame_Arena::reserve(size_t capacity) {
+	capacity = aligned(capacity);
+	if(capacity <= capacity_) return;
+	
+	buffer_.reset(new unsigned char[capacity]);
+	capacity_ = capacity;
+	used_ = 0;
+}
+
+void Frame_Arena::reset() {
+	if(overflow_size_ > 0) {	// the last step didn't fit, make room for it
+		size_t needed(used_ + overflow_size_);
+		overflow_blocks_.clear();
+		overflow_size_ = 0;
+		reserve(std::max(needed, 2 * capacity_));
+	}
+	used_ = 0;
+}
+
+void* Frame_Arena::allocate_bytes(size_t size) {
+	size = aligned(std::max(size, size_t(1)));
+	
+	if(used_ + size <= capacity_) {
+		void* memory(buffer_.get() + used_);
+		used_ += size;
+		return memory;
+	}
+	overflow_blocks_.emplace_back(new unsigned char[size]);
+	overflow_size_ += size;
+	return overflow_blocks_.back().get();
+}
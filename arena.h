@@ -0,0 +1,65 @@
+/**
+ * file: arena.h
+ * 
+ * authors:	Cem Keske
+ * 			Emre Yazici
+ */
+#ifndef ARENA_H_INCLUDED
+#define ARENA_H_INCLUDED
+
+#include <vector>
+#include <memory>
+#include <cstddef>
+
+/// FRAME ARENA ///
+/**
+ * Bump allocator for the temporaries of one simulation step. Allocations are never 
+ * freed one by one: reset() at the beginning of a step releases all of them.
+ * 
+ * When a step needs more memory than the buffer holds, extra blocks are taken from
+ * the heap and the buffer is enlarged to the total at the next reset(). After the 
+ * first few steps no heap allocation happens anymore.
+ * 
+ * Only trivially destructible types should be allocated (no destructor is called).
+ */
+class Frame_Arena {
+	
+	private:
+		std::unique_ptr<unsigned char[]> buffer_;
+		size_t capacity_;
+		size_t used_;
+		
+		std::vector<std::unique_ptr<unsigned char[]>> overflow_blocks_;
+		size_t overflow_size_;
+	
+	public:
+		
+		// ===== Constructor =====
+		
+		Frame_Arena(size_t capacity = 0);
+		
+		// ===== Accessors =====
+		
+		size_t capacity() const;
+		size_t used() const;
+		
+		// ===== Methods =====
+		
+		void reserve(size_t capacity);
+		void reset();
+		
+		/**
+		 * Returns uninitialised room for "count" objects of type T, valid until the 
+		 * next reset().
+		 */
+		template <typename T>
+		T* allocate(size_t count) {
+			return static_cast<T*>(allocate_bytes(count * sizeof(T)));
+		}
+		
+	private:
+		
+		void* allocate_bytes(size_t size);
+};
+
+#endif
@@ -0,0 +1,309 @@
+/**
+ * file: ensemble.cc
+ * 
+ * authors:	Cem Keske
+ * 			Emre Yazici
+ */
+#include "ensemble.h"
+#include "define.h"
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <numeric>
+#include <limits>
+#include <map>
+
+static constexpr size_t DEFAULT_NB_STEPS(1000);
+static const std::string DEFAULT_OUTPUT_PATH("ensemble.csv");
+
+static const std::vector<std::string> PARAMETER_NAMES = {
+	"COEF_RAYON_JOUEUR", "COEF_VITESSE_JOUEUR", "COEF_RAYON_BALLE", 
+	"COEF_VITESSE_BALLE", "COEF_MARGE_JEU", "MAX_COUNT", "SWEPT_BALLS"};
+
+static bool is_parameter(const std::string& key);
+static void set_parameter(Simulation_Parameters&, const std::string& key, double);
+
+/// ===== ENSEMBLE ===== ///
+
+
+// ===== Constructor =====
+
+Ensemble::Ensemble() : nb_steps_(DEFAULT_NB_STEPS), 
+					   output_path_(DEFAULT_OUTPUT_PATH) {}
+
+// ===== Accessors =====
+
+size_t Ensemble::nb_scenarios() const {
+	size_t nb_scenarios(scenarios_.size());
+	for(const auto& generation : generations_)
+		nb_scenarios += generation.count;
+	return nb_scenarios;
+}
+
+size_t Ensemble::nb_runs() const {
+	return std::max<size_t>(parameter_sets_.size(), 1) * nb_scenarios();
+}
+
+const std::string& Ensemble::output_path() const {return output_path_;}
+
+// ===== Methods =====
+
+bool Ensemble::read_spec(const std::string& spec_path) {
+	std::ifstream in_file(spec_path);
+	if(in_file.fail()) {
+		std::cout << "File : \"" << spec_path << "\" can't be read." << std::endl;
+		return false;
+	}
+	
+	std::string line, key;
+	size_t line_number(0);
+	while(getline(in_file, line)) {
+		++line_number;
+		std::istringstream values(line);
+		if(!(values >> key) || key[0] == '#') continue;
+		
+		if(read_entry(key, values) == false) {
+			std::cout << spec_path << ", line " << line_number << ": \"" << line 
+					  << "\" is not valid." << std::endl;
+			return false;
+		}
+	}
+	if(nb_scenarios() == 0) {
+		std::cout << spec_path << ": no scenario (FILE or GENERATE)." << std::endl;
+		return false;
+	}
+	build_parameter_sets();
+	return true;
+}
+
+/**
+ * Runs all scenarios with all parameter sets in parallel (see 
+ * Simulator::run_scenarios), once per swept MAX_COUNT since the generated scenarios
+ * depend on it. The results are in the order of a single run.
+ */
+void Ensemble::run() {
+	size_t nb_scenarios(this->nb_scenarios());
+	results_.assign(parameter_sets_.size() * nb_scenarios, Run_Result());
+	
+	std::map<Counter, std::vector<size_t>> sets_by_max_count;
+	for(size_t p(0); p < parameter_sets_.size(); ++p)
+		sets_by_max_count[parameter_sets_[p].max_count].push_back(p);
+	
+	for(const auto& sets : sets_by_max_count) {
+		std::vector<Simulation_Parameters> parameter_sets;
+		for(size_t p : sets.second)
+			parameter_sets.push_back(parameter_sets_[p]);
+		
+		std::vector<Run_Result> results(Simulator::run_scenarios(
+							scenarios(sets.first), parameter_sets, nb_steps_));
+		for(size_t i(0); i < sets.second.size(); ++i)
+			std::copy_n(results.begin() + i * nb_scenarios, nb_scenarios, 
+						results_.begin() + sets.second[i] * nb_scenarios);
+	}
+}
+
+/**
+ * One line per parameter set. The statistics are computed on the scenarios that could
+ * be loaded with that parameter set, "steps to game over" only on those that ended.
+ */
+bool Ensemble::write_csv(const std::string& csv_path) const {
+	std::ofstream o_file(csv_path);
+	if(!o_file) return false;
+	
+	for(const auto& name : PARAMETER_NAMES)
+		o_file << name << ",";
+	o_file << "runs,loaded,game_over,player_trapped,mean_steps,mean_steps_to_game_over,"
+			  "min_steps_to_game_over,max_steps_to_game_over,mean_survivors,"
+			  "mean_obstacles_destroyed\n";
+	o_file.precision(std::numeric_limits<double>::digits10);
+	
+	size_t nb_scenarios(this->nb_scenarios());
+	for(size_t p(0); p < parameter_sets_.size(); ++p) {
+		const Simulation_Parameters& parameters(parameter_sets_[p]);
+		
+		size_t nb_loaded(0), nb_game_over(0), nb_trapped(0);
+		size_t total_steps(0), game_over_steps(0), total_survivors(0), total_destroyed(0);
+		size_t min_steps(std::numeric_limits<size_t>::max()), max_steps(0);
+		
+		for(size_t s(0); s < nb_scenarios; ++s) {
+			const Run_Result& result(results_[p * nb_scenarios + s]);
+			if(result.loaded == false) continue;
+			
+			++nb_loaded;
+			total_steps += result.nb_steps;
+			total_survivors += result.nb_survivors;
+			total_destroyed += result.nb_obstacles_destroyed;
+			if(result.state == PLAYER_TRAPPED) ++nb_trapped;
+			if(result.state == GAME_OVER) {
+				++nb_game_over;
+				game_over_steps += result.nb_steps;
+				min_steps = std::min(min_steps, result.nb_steps);
+				max_steps = std::max(max_steps, result.nb_steps);
+			}
+		}
+		
+		auto mean = [](size_t total, size_t count) {
+			return count == 0 ? 0. : total / (double) count;
+		};
+		o_file << parameters.coef_player_radius << "," << parameters.coef_player_speed 
+			   << "," << parameters.coef_ball_radius << "," 
+			   << parameters.coef_ball_speed << "," << parameters.coef_marge_jeu 
+			   << "," << parameters.max_count << "," << parameters.swept_balls << ","
+			   << nb_scenarios << "," 
+			   << nb_loaded << "," << nb_game_over << "," << nb_trapped << "," 
+			   << mean(total_steps, nb_loaded) << "," 
+			   << mean(game_over_steps, nb_game_over) << "," 
+			   << (nb_game_over == 0 ? 0 : min_steps) << "," << max_steps << "," 
+			   << mean(total_survivors, nb_loaded) << ","
+			   << mean(total_destroyed, nb_loaded) << "\n";
+	}
+	return bool(o_file);
+}
+
+// ===== Private methods =====
+
+bool Ensemble::read_entry(const std::string& key, std::istringstream& values) {
+	if(is_parameter(key)) {
+		std::vector<double> sweep;
+		double value(0);
+		while(values >> value)
+			sweep.push_back(value);
+		if(sweep.empty() || !values.eof()) return false;
+		// sizes and speeds must be positive (a ball speed of 0 never leaves)
+		if(key.compare(0, 5, "COEF_") == 0 && 
+		   std::any_of(sweep.begin(), sweep.end(), [](double v) {return !(v > 0);}))
+			return false;
+		
+		sweeps_.emplace_back(key, sweep);
+		return true;
+	}
+	if(key == "FILE") {
+		std::string file_path;
+		return (values >> file_path) && load_scenario(file_path);
+	}
+	if(key == "GENERATE") {
+		size_t nb_cells(0), nb_players(0), nb_obstacles(0), count(0);
+		unsigned seed(0);
+		return (values >> nb_cells >> nb_players >> nb_obstacles >> count >> seed) &&
+			   generate_scenarios(nb_cells, nb_players, nb_obstacles, count, seed);
+	}
+	if(key == "STEPS")
+		return bool(values >> nb_steps_);
+	if(key == "OUTPUT")
+		return bool(values >> output_path_);
+	
+	return false;
+}
+
+bool Ensemble::load_scenario(const std::string& file_path) {
+	std::ifstream in_file(file_path);
+	if(in_file.fail()) return false;
+	
+	std::ostringstream data;
+	data << in_file.rdbuf();
+	scenarios_.push_back(data.str());
+	return true;
+}
+
+bool Ensemble::generate_scenarios(size_t nb_cells, size_t nb_players, 
+								  size_t nb_obstacles, size_t count, unsigned seed) {
+	if(nb_cells < MIN_CELL || nb_cells > MAX_CELL || 
+	   nb_players + nb_obstacles > nb_cells * nb_cells) 
+		return false;
+	
+	generations_.push_back({nb_cells, nb_players, nb_obstacles, count, seed});
+	return true;
+}
+
+/**
+ * Cartesian product of all swept values. The last swept parameter varies fastest.
+ */
+void Ensemble::build_parameter_sets() {
+	parameter_sets_.assign(1, Simulation_Parameters());
+	
+	for(const auto& sweep : sweeps_) {
+		std::vector<Simulation_Parameters> parameter_sets;
+		for(const auto& parameters : parameter_sets_) {
+			for(double value : sweep.second) {
+				parameter_sets.push_back(parameters);
+				set_parameter(parameter_sets.back(), sweep.first, value);
+			}
+		}
+		parameter_sets_.swap(parameter_sets);
+	}
+}
+
+/**
+ * The FILE scenarios, then the GENERATE ones with cooldowns below "max_count". A 
+ * GENERATE entry restarts from its seed, so it gives the same cells and lives for
+ * every max_count.
+ */
+std::vector<std::string> Ensemble::scenarios(Counter max_count) const {
+	std::vector<std::string> scenarios(scenarios_);
+	for(const auto& generation : generations_) {
+		std::mt19937 generator(generation.seed);
+		for(size_t i(0); i < generation.count; ++i)
+			scenarios.push_back(generate_scenario(generation.nb_cells, 
+												  generation.nb_players, 
+												  generation.nb_obstacles, max_count,
+												  generator));
+	}
+	return scenarios;
+}
+
+/// ===== SCENARIO GENERATION ===== ///
+
+std::string generate_scenario(size_t nb_cells, size_t nb_players, size_t nb_obstacles,
+							  Counter max_count, std::mt19937& generator) {
+	
+	// a random permutation of the cells: players first, then obstacles
+	std::vector<size_t> cells(nb_cells * nb_cells);
+	std::iota(cells.begin(), cells.end(), 0);
+	for(size_t i(0); i < nb_players + nb_obstacles; ++i) {
+		std::uniform_int_distribution<size_t> pick(i, cells.size() - 1);
+		std::swap(cells[i], cells[pick(generator)]);
+	}
+	
+	// cooldowns on their own generator: the other draws don't depend on max_count
+	std::mt19937 cooldown_generator(generator());
+	std::uniform_int_distribution<Counter> lives(1, MAX_TOUCH);
+	std::uniform_int_distribution<Counter> cooldown(0, max_count - 1);
+	double cell_side(SIDE / nb_cells);
+	
+	std::ostringstream os_stream;
+	os_stream.precision(std::numeric_limits<double>::max_digits10);
+	os_stream << "# generated scenario\n" << nb_cells << "\n";
+	
+	os_stream << "# players\n" << nb_players << "\n";
+	for(size_t i(0); i < nb_players; ++i) {
+		size_t line(cells[i] / nb_cells), col(cells[i] % nb_cells);
+		os_stream << -DIM_MAX + (col + 0.5) * cell_side << " " 
+				  << DIM_MAX - (line + 0.5) * cell_side << " " << lives(generator)
+				  << " " << cooldown(cooldown_generator) << "\n";
+	}
+	
+	os_stream << "# obstacles\n" << nb_obstacles << "\n";
+	for(size_t i(nb_players); i < nb_players + nb_obstacles; ++i)
+		os_stream << cells[i] / nb_cells << " " << cells[i] % nb_cells << "\n";
+	
+	os_stream << "# balls\n0\n";
+	return os_stream.str();
+}
+
+/// ===== STATIC FUNCTIONS ===== ///
+
+static bool is_parameter(const std::string& key) {
+	return std::find(PARAMETER_NAMES.begin(), PARAMETER_NAMES.end(), key) != 
+		   PARAMETER_NAMES.end();
+}
+
+static void set_parameter(Simulation_Parameters& parameters, const std::string& key,
+						  double value) {
+	if(key == "COEF_RAYON_JOUEUR") parameters.coef_player_radius = value;
+	else if(key == "COEF_VITESSE_JOUEUR") parameters.coef_player_speed = value;
+	else if(key == "COEF_RAYON_BALLE") parameters.coef_ball_radius = value;
+	else if(key == "COEF_VITESSE_BALLE") parameters.coef_ball_speed = value;
+	else if(key == "COEF_MARGE_JEU") parameters.coef_marge_jeu = value;
+	else if(key == "MAX_COUNT") parameters.max_count = std::max(1., value);
+	else if(key == "SWEPT_BALLS") parameters.swept_balls = (value != 0);
+}
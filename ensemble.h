@@ -0,0 +1,97 @@
+/**
+ * file: ensemble.h
+ * 
+ * authors:	Cem Keske
+ * 			Emre Yazici
+ */
+#ifndef ENSEMBLE_H_INCLUDED
+#define ENSEMBLE_H_INCLUDED
+
+#include "simulation.h"
+#include <string>
+#include <vector>
+#include <utility>
+#include <random>
+#include <sstream>
+
+/// ENSEMBLE ///
+/**
+ * Monte-Carlo runner: every scenario is run headless with every combination of the
+ * swept arena parameters, and the outcomes are aggregated per parameter set into a
+ * csv file.
+ * 
+ * Sweep specification, one entry per line ('#' starts a comment):
+ * 
+ * 		COEF_RAYON_JOUEUR	0.2 0.25 0.3	(also COEF_VITESSE_JOUEUR, COEF_RAYON_BALLE,
+ * 		MAX_COUNT			10 20 40		 COEF_VITESSE_BALLE and COEF_MARGE_JEU)
+ * 		SWEPT_BALLS			0 1				(continuous ball collisions, off by default)
+ * 		FILE				input.txt		(a scenario from a simulation file)
+ * 		GENERATE			20 10 40 100 7	(nb_cells nb_players nb_obstacles count seed:
+ * 											 "count" random scenarios)
+ * 		STEPS				2000			(steps per run at most, default 1000)
+ * 		OUTPUT				results.csv		(default ensemble.csv)
+ * 
+ * A parameter that is not swept keeps its value of define.h.
+ */
+class Ensemble {
+	
+	private:
+		std::vector<std::pair<std::string, std::vector<double>>> sweeps_;
+		
+		std::vector<std::string> scenarios_;		//FILE entries, input file format
+		
+		/// GENERATE entries, generated for each MAX_COUNT (it bounds the cooldowns)
+		struct Generation {
+			size_t nb_cells;
+			size_t nb_players;
+			size_t nb_obstacles;
+			size_t count;
+			unsigned seed;
+		};
+		std::vector<Generation> generations_;
+		
+		size_t nb_steps_;
+		std::string output_path_;
+		
+		std::vector<Simulation_Parameters> parameter_sets_;
+		std::vector<Run_Result> results_;
+	
+	public:
+		
+		// ===== Constructor =====
+		
+		Ensemble();
+		
+		// ===== Accessors =====
+		
+		size_t nb_scenarios() const;
+		size_t nb_runs() const;
+		const std::string& output_path() const;
+		
+		// ===== Methods =====
+		
+		/// prints the first faulty line and returns false if the file can't be used
+		bool read_spec(const std::string& spec_path);
+		
+		void run();
+		bool write_csv(const std::string& csv_path) const;
+		
+	private:
+		
+		bool read_entry(const std::string& key, std::istringstream& values);
+		bool load_scenario(const std::string& file_path);
+		bool generate_scenarios(size_t nb_cells, size_t nb_players, 
+								size_t nb_obstacles, size_t count, unsigned seed);
+		void build_parameter_sets();
+		std::vector<std::string> scenarios(Counter max_count) const;
+};
+
+/**
+ * Returns a random simulation in input file format: players at the center of distinct
+ * free cells with random lives and cooldown (in [0, max_count)), obstacles on other 
+ * cells, no balls. The cells and lives don't depend on max_count.
+ */
+std::string generate_scenario(size_t nb_cells, size_t nb_players, size_t nb_obstacles,
+							  Counter max_count, std::mt19937& generator);
+
+#endif
@@ -15,7 +15,10 @@
 
 static constexpr int default_border_thickness(3);
 static constexpr double circle_arc_ratio(0.35);	//between radius and arc's thickness
-static constexpr int delta_t_ms((int)(DELTA_T * 1000)); //DELTA_T converted to ms
+static constexpr int frame_ms(16);	//redraw period while the simulation runs
+static constexpr double rate_period(0.5);	//seconds between updates of steps/s
+static constexpr int replay_ms(DELTA_T*1000);	//period of a replayed step
+static constexpr size_t replay_fast_steps(16);	//steps per period in fast mode
 static constexpr double starting_angle(M_PI_2*3); 	//the angle where the arcs start
 static std::string labels[] = {"Start","Stop"};
 
@@ -53,6 +56,33 @@ bool file_exists(const std::string& file_path){
 	return file_to_check.good();
 }
 
+/**
+ * Both formats can be opened whatever the name of the file, a file is saved in the
+ * binary snapshot format if its name ends with ".snap".
+ */
+void add_file_filters(Gtk::FileChooserDialog& file_dialog){
+	auto all_formats(Gtk::FileFilter::create());
+	all_formats->set_name("Simulation files (*.txt, *.snap)");
+	all_formats->add_pattern("*.txt");
+	all_formats->add_pattern("*.snap");
+	file_dialog.add_filter(all_formats);
+	
+	auto text_format(Gtk::FileFilter::create());
+	text_format->set_name("Text (*.txt)");
+	text_format->add_pattern("*.txt");
+	file_dialog.add_filter(text_format);
+	
+	auto binary_format(Gtk::FileFilter::create());
+	binary_format->set_name("Binary snapshot (*.snap)");
+	binary_format->add_pattern("*.snap");
+	file_dialog.add_filter(binary_format);
+	
+	auto all_files(Gtk::FileFilter::create());
+	all_files->set_name("All files");
+	all_files->add_pattern("*");
+	file_dialog.add_filter(all_files);
+}
+
 
 
 
@@ -68,15 +98,54 @@ Canvas::Canvas() : center(DIM_MAX,DIM_MAX) {
 bool Canvas::on_draw(const Cairo::RefPtr<Cairo::Context>& cr){
 		
 	draw_background(cr); //this gets onto te old display
-	if(Simulator::empty() == false) {
-		draw_all_player_graphics(cr);
-		draw_all_rectangle_graphics(cr);
-		draw_all_ball_graphics(cr);
+	const Render_Snapshot& snapshot(replay_ ? replay_snapshot_ 
+											: Simulator::fetch_snapshot());
+	if(snapshot.state != NO_GAME) {
+		draw_all_player_graphics(snapshot, cr);
+		draw_all_rectangle_graphics(snapshot, cr);
+		draw_all_ball_graphics(snapshot, cr);
 	}
 	draw_border(cr, default_border_thickness);	
 	return true;
 }
 
+/**
+ * The previous replay goes on if "file_path" isn't a recording.
+ */
+bool Canvas::start_replay(const std::string& file_path){
+	std::unique_ptr<Trajectory_Replay> replay(new Trajectory_Replay(file_path));
+	if(replay->is_valid() == false)
+		return false;
+	
+	replay_ = std::move(replay);
+	replay_snapshot_ = Render_Snapshot();
+	seek(replay_->first_step());
+	return true;
+}
+
+void Canvas::stop_replay(){
+	replay_.reset();
+}
+
+bool Canvas::replay_mode() const {return replay_ != nullptr;}
+
+const Trajectory_Replay& Canvas::replay() const {return *replay_;}
+
+/**
+ * Decodes from the keyframe before "step" at most (see Trajectory_Replay), a bad
+ * frame leaves the previous one on the canvas.
+ */
+size_t Canvas::seek(size_t step){
+	size_t index(replay_->frame_index(step));
+	if(replay_->frame(index, replay_frame_)) {
+		Simulator::fill_snapshot(replay_frame_, replay_snapshot_);
+		replay_snapshot_.nb_steps = replay_->frame_step(index);
+	}
+	return replay_snapshot_.nb_steps;
+}
+
+size_t Canvas::replay_step() const {return replay_snapshot_.nb_steps;}
+
 Coordinate Canvas::convert_coordinate(Coordinate const& pos){
 	return {center.x + pos.x , center.y - pos.y };
 }
@@ -158,13 +227,14 @@ void Canvas::draw_rectangle(Rectangle const& original,
 }
 
 /**
- * Draws graphics for players requesting the shapes to draw from the simulation module. 
+ * Draws graphics for players from the snapshot of the simulation. 
  */
-void Canvas::draw_all_player_graphics(const Cairo::RefPtr<Cairo::Context>& cr) {
+void Canvas::draw_all_player_graphics(Render_Snapshot const& snapshot,
+									  const Cairo::RefPtr<Cairo::Context>& cr) {
 	
-	for (auto const& circled_arc : Simulator::fetch_player_graphics()) {
+	for (auto const& circled_arc : snapshot.players) {
 		//get the circle, color and angle from the tuple
-		Circle const& circ(*(std::get<0>(circled_arc))); 	//circle at '0'
+		Circle const& circ(std::get<0>(circled_arc)); 		//circle at '0'
 		Angle arc_angle(std::get<1>(circled_arc)); 			//angle at '1'
 		Color const& color(predefined_color_chooser(std::get<2>(circled_arc)));
 		
@@ -176,20 +246,22 @@ void Canvas::draw_all_player_graphics(const Cairo::RefPtr<Cairo::Context>& cr) {
 }
 
 /**
- * Draws graphics for rectangles requesting the shapes to draw from simulation. 
+ * Draws graphics for rectangles from the snapshot of the simulation. 
  */
-void Canvas::draw_all_rectangle_graphics(const Cairo::RefPtr<Cairo::Context>& cr){
-	for (auto rectangle : Simulator::fetch_obstacle_bodies()){
-		draw_rectangle(*rectangle, cr);
+void Canvas::draw_all_rectangle_graphics(Render_Snapshot const& snapshot,
+										 const Cairo::RefPtr<Cairo::Context>& cr){
+	for (auto const& rectangle : snapshot.obstacles){
+		draw_rectangle(rectangle, cr);
 	}
 }
 
 /**
- * Draws graphics for balls requesting the circles to draw from simulation.
+ * Draws graphics for balls from the snapshot of the simulation.
  */
-void Canvas::draw_all_ball_graphics(const Cairo::RefPtr<Cairo::Context>& cr){
-	for (auto circle : Simulator::fetch_ball_bodies()){
-		draw_disk(*circle, cr);
+void Canvas::draw_all_ball_graphics(Render_Snapshot const& snapshot,
+									const Cairo::RefPtr<Cairo::Context>& cr){
+	for (auto const& circle : snapshot.balls){
+		draw_disk(circle, cr);
 	}	
 }
 
@@ -202,9 +274,16 @@ Gui_Window::Gui_Window() :
 	button_open("Open"),
 	button_save("Save"),
 	button_start_stop("Start"),
+	button_fast("Fast"),
 	button_step("Step"),
+	button_step_back("Step back"),
+	button_replay("Replay"),
 	label_message(state_to_string(Simulator::active_simulation_state())),
-	timer_running(false) {
+	replay_scale(Gtk::ORIENTATION_HORIZONTAL),
+	timer_running(false),
+	steps_per_second(0),
+	rate_steps(0),
+	save_succeeded(false) {
 	
 	set_title("DodgeBall");
 	//initialize the button panel
@@ -213,13 +292,25 @@ Gui_Window::Gui_Window() :
 	connect_buttons_to_handlers();
 	//initialize the canvas
 	sim_arena.add(canvas);
+	//the replay scale shows the step number, it appears in replay mode
+	replay_scale.set_digits(0);
 	//add components to the big box
 	the_big_box.add(interaction_box);
+	the_big_box.add(replay_scale);
 	the_big_box.add(sim_arena);
 	//add the big box to the window and show everything
 	add(the_big_box);
 	set_resizable(false);
 	show_all_children();
+	replay_scale.hide();
+}
+
+/**
+ * The simulation thread must be joined before the window (and the program) ends.
+ */
+Gui_Window::~Gui_Window() {
+	stop_timer();
+	Simulator::finish_save();	//it reports to save_dispatcher
 }
 
 
@@ -227,6 +318,8 @@ Gui_Window::Gui_Window() :
 // ===== Button Handlers =====
 
 void Gui_Window::on_button_clicked_exit(){
+	stop_timer();
+	Simulator::finish_save();
 	exit(0);
 }
 
@@ -241,12 +334,16 @@ void Gui_Window::on_button_clicked_open(){
 		
 	file_dialog.add_button("Open", Gtk::RESPONSE_OK);
 	file_dialog.add_button("Cancel", Gtk::RESPONSE_CANCEL);
+	add_file_filters(file_dialog);
 	
 	response = file_dialog.run();
 	file_adress = file_dialog.get_filename();
 	}//dialog window destroyed, we don't want to see it on the screen anymore
 	
 	if(response == Gtk::RESPONSE_OK){
+		stop_timer();	//the running simulation is about to be replaced
+		button_replay.set_active(false);	//show it
+		save_status.clear();
 		if(Simulator::import_file(file_adress)){
 			show_message("File succesfully imported");
 			//refresh the window after importing
@@ -258,7 +355,7 @@ void Gui_Window::on_button_clicked_open(){
 }
 
 void Gui_Window::on_button_clicked_save(){
-	if(Simulator::active_simulation_state() == NO_GAME){
+	if(Simulator::fetch_snapshot().state == NO_GAME){
 		show_warning("There's no active simulation to save!");
 		return;
 	}
@@ -270,6 +367,7 @@ void Gui_Window::on_button_clicked_save(){
 	//Add dialog buttons
 	file_dialog.add_button("Save", Gtk::RESPONSE_OK);
 	file_dialog.add_button("Cancel", Gtk::RESPONSE_CANCEL);
+	add_file_filters(file_dialog);
 	
 	int response = file_dialog.run();
 	
@@ -282,8 +380,18 @@ void Gui_Window::on_button_clicked_save(){
 								 "The existing simulation data in this file"
 								 " will be lost.");
 		if(write){
-			Simulator::save_simulation(file_path);
-			show_message("Simulation saved to: " + file_path);
+			//the game keeps running, its state is copied between two steps
+			bool started(Simulator::save_in_background(file_path, 
+													   [this](bool success) {
+				save_succeeded = success;
+				save_dispatcher.emit();
+			}));
+			if(started) {
+				save_path = file_path;
+				save_status = "Saving to " + file_path + "...";
+			} else {
+				show_warning("The previous save is not finished yet!");
+			}
 		}
 	}
 	refresh();
@@ -291,7 +399,7 @@ void Gui_Window::on_button_clicked_save(){
 
 void Gui_Window::on_button_clicked_start_stop(){
 	
-	if(Simulator::active_simulation_state() == NO_GAME) {
+	if(canvas.replay_mode() == false && Simulator::fetch_snapshot().state == NO_GAME) {
 		show_warning("No game to start or stop!");
 		return;
 	}
@@ -305,8 +413,19 @@ void Gui_Window::on_button_clicked_start_stop(){
 	}
 }
 
+/**
+ * Can be toggled while the simulation runs, see Simulator::fast_mode.
+ */
+void Gui_Window::on_button_toggled_fast(){
+	Simulator::fast_mode(button_fast.get_active());
+	update_step_rate(true);	//don't mix the two speeds in the readout
+}
+
 void Gui_Window::on_button_clicked_step(){
-	if(Simulator::active_simulation_state() == GAME_READY){
+	stop_timer();	//stepping by hand pauses the simulation thread
+	if(canvas.replay_mode()){
+		advance_replay(1);
+	} else if(Simulator::active_simulation_state() == GAME_READY){
 		Simulator::update_active_sim(DELTA_T);
 		refresh();
 	} else {
@@ -314,42 +433,201 @@ void Gui_Window::on_button_clicked_step(){
 	}
 }
 
+/**
+ * Goes back one step with the copies kept by Simulator (see step_back), or to the 
+ * previous step of the recording in replay mode.
+ */
+void Gui_Window::on_button_clicked_step_back(){
+	stop_timer();
+	if(canvas.replay_mode()){
+		if(canvas.replay_step() > canvas.replay().first_step())
+			replay_scale.set_value(canvas.replay_step() - 1);
+	} else if(Simulator::step_back()){
+		refresh();
+	} else {
+		show_warning("Can't step back any further!");
+	}
+}
+
+/**
+ * The simulation is paused while a recording is replayed, it is shown again when 
+ * leaving replay mode.
+ */
+void Gui_Window::on_button_toggled_replay(){
+	if(button_replay.get_active() == canvas.replay_mode())
+		return;	//set back below
+	stop_timer();
+	
+	if(button_replay.get_active()){
+		std::string file_path(ask_replay_file());
+		if(file_path.empty() == false && canvas.start_replay(file_path)){
+			const Trajectory_Replay& replay(canvas.replay());
+			replay_scale.set_range(replay.first_step(), replay.last_step());
+			replay_scale.set_increments(1, Trajectory::keyframe_interval);
+			replay_scale.set_value(replay.first_step());
+			replay_scale.show();
+		} else {
+			if(file_path.empty() == false)
+				show_warning("This file is not a recording of a game!");
+			button_replay.set_active(false);
+		}
+	} else {
+		canvas.stop_replay();
+		replay_scale.hide();
+	}
+	refresh();
+}
+
 
 // ===== Timer Utilites =====
 
+/**
+ * The simulation runs on its own thread (see Simulator::start_sim_thread), the timer
+ * only redraws its latest snapshot. Redraws and steps thus have independent rates.
+ */
 bool Gui_Window::timer_tick(){
 	if(timer_running == true){
-		Simulator::update_active_sim(DELTA_T);
-		refresh(); //refresh the gui window after updating the simulation
-		if(Simulator::active_simulation_state() != GAME_READY){ 
+		update_step_rate();
+		refresh(); //draw the latest published step
+		if(Simulator::fetch_snapshot().state != GAME_READY){ 
 		//when there's no sim to run
 			stop_timer();
-			on_draw(get_window()->create_cairo_context());
+			refresh();
 		}
 	}
 	return timer_running;
 }
 
 
+bool Gui_Window::replay_tick(){
+	if(timer_running == true){
+		advance_replay(button_fast.get_active() ? replay_fast_steps : 1);
+		if(canvas.replay_step() >= canvas.replay().last_step()){
+			stop_timer();
+			refresh();
+		}
+	}
+	return timer_running;
+}
+
+
+/**
+ * In replay mode the timer plays the recording, from its start once it has been
+ * played to the end.
+ */
 bool Gui_Window::start_timer(){
 	if(timer_running)
 		return false;
 	
+	if(canvas.replay_mode()){
+		if(canvas.replay_step() >= canvas.replay().last_step())
+			replay_scale.set_value(canvas.replay().first_step());
+		frame_timer = Glib::signal_timeout().connect(
+						sigc::mem_fun(*this, &Gui_Window::replay_tick), replay_ms);
+		timer_running = true;
+		return true;
+	}
+	
 	//timer was not running	, so start the action
+	if(Simulator::start_sim_thread() == false)
+		return false;
 	
-	Glib::signal_timeout().connect(sigc::mem_fun(*this, &Gui_Window::timer_tick),
-												  delta_t_ms);
+	frame_timer = Glib::signal_timeout().connect(
+						sigc::mem_fun(*this, &Gui_Window::timer_tick), frame_ms);
 	timer_running = true;
+	update_step_rate(true);
 	return true;
 }
 bool Gui_Window::stop_timer(){
 	if(timer_running == false)
 		return false; //timer is not running
+	frame_timer.disconnect();
+	Simulator::stop_sim_thread();
 	timer_running = false;
 	return true;
 }
 
 
+/**
+ * The rate is measured over rate_period so that the readout doesn't flicker. 
+ * "restart" starts a new measure from the latest snapshot.
+ */
+void Gui_Window::update_step_rate(bool restart){
+	auto now(std::chrono::steady_clock::now());
+	size_t nb_steps(Simulator::fetch_snapshot().nb_steps);
+	
+	if(restart) {
+		steps_per_second = 0;
+	} else {
+		double elapsed(std::chrono::duration<double>(now - rate_time).count());
+		if(elapsed < rate_period)
+			return;
+		steps_per_second = (nb_steps - rate_steps) / elapsed;
+	}
+	rate_steps = nb_steps;
+	rate_time = now;
+}
+
+
+// ===== Background Save =====
+
+/**
+ * Called on the gui thread once the saving thread is done.
+ */
+void Gui_Window::on_save_finished(){
+	if(save_succeeded)
+		save_status = "Saved to " + save_path;
+	else
+		save_status = "Could not save to " + save_path;
+	refresh();
+}
+
+
+// ===== Replay =====
+
+/**
+ * Every change of step goes through here, whether from the scale, the timer or Step.
+ */
+void Gui_Window::on_replay_scale_changed(){
+	if(canvas.replay_mode()){
+		canvas.seek(std::lround(replay_scale.get_value()));
+		refresh();
+	}
+}
+
+/**
+ * The scale stops at the last step.
+ */
+void Gui_Window::advance_replay(size_t nb_steps){
+	replay_scale.set_value(canvas.replay_step() + nb_steps);
+}
+
+/**
+ * Empty if cancelled
+ */
+std::string Gui_Window::ask_replay_file(){
+	Gtk::FileChooserDialog file_dialog("Please choose a recording", 
+										Gtk::FILE_CHOOSER_ACTION_OPEN); 
+	file_dialog.set_transient_for(*this);
+	file_dialog.add_button("Replay", Gtk::RESPONSE_OK);
+	file_dialog.add_button("Cancel", Gtk::RESPONSE_CANCEL);
+	
+	auto recordings(Gtk::FileFilter::create());
+	recordings->set_name("Recordings (*.traj)");
+	recordings->add_pattern("*.traj");
+	file_dialog.add_filter(recordings);
+	
+	auto all_files(Gtk::FileFilter::create());
+	all_files->set_name("All files");
+	all_files->add_pattern("*");
+	file_dialog.add_filter(all_files);
+	
+	if(file_dialog.run() != Gtk::RESPONSE_OK)
+		return "";
+	return file_dialog.get_filename();
+}
+
+
 // ===== Other Utility Methods =====
 
 void Gui_Window::connect_buttons_to_handlers(){
@@ -361,8 +639,17 @@ void Gui_Window::connect_buttons_to_handlers(){
 										   &Gui_Window::on_button_clicked_save));  
 	button_start_stop.signal_clicked().connect(sigc::mem_fun(*this,
 										   &Gui_Window::on_button_clicked_start_stop));	  
+	button_fast.signal_toggled().connect(sigc::mem_fun(*this,
+										   &Gui_Window::on_button_toggled_fast));
 	button_step.signal_clicked().connect(sigc::mem_fun(*this,
 										   &Gui_Window::on_button_clicked_step));
+	button_step_back.signal_clicked().connect(sigc::mem_fun(*this,
+										   &Gui_Window::on_button_clicked_step_back));
+	button_replay.signal_toggled().connect(sigc::mem_fun(*this,
+										   &Gui_Window::on_button_toggled_replay));
+	replay_scale.signal_value_changed().connect(sigc::mem_fun(*this,
+										   &Gui_Window::on_replay_scale_changed));
+	save_dispatcher.connect(sigc::mem_fun(*this, &Gui_Window::on_save_finished));
 }
 
 void Gui_Window::add_button_panel_components(){
@@ -370,7 +657,10 @@ void Gui_Window::add_button_panel_components(){
 	interaction_box.pack_start(button_open);
 	interaction_box.pack_start(button_save);
 	interaction_box.pack_start(button_start_stop);
+	interaction_box.pack_start(button_fast);
 	interaction_box.pack_start(button_step);
+	interaction_box.pack_start(button_step_back);
+	interaction_box.pack_start(button_replay);
 	interaction_box.pack_start(label_message);
 }
 
@@ -380,7 +670,8 @@ void Gui_Window::add_button_panel_components(){
 // ===== Refresher =====
 
 /**
- * Refreshes the gui window and all subcomponents using the current simulation.
+ * Refreshes the gui window and all subcomponents using the latest snapshot of the 
+ * simulation.
  * 
  * !!! This function does not occupy calling the update method of the simulation !!!
  * !!! Simulation should be updated explicitly before calling this function !!!
@@ -388,8 +679,16 @@ void Gui_Window::add_button_panel_components(){
 void Gui_Window::refresh(){
 	
 	//change the message shown if necessary
-	Simulation_State state(Simulator::active_simulation_state());
-	label_message.set_text(state_to_string(state));
+	Simulation_State state(Simulator::fetch_snapshot().state);
+	std::string message(state_to_string(state));
+	if(canvas.replay_mode())
+		message = "Replay: step " + std::to_string(canvas.replay_step()) + " / " 
+				  + std::to_string(canvas.replay().last_step());
+	else if(timer_running)
+		message += "  " + std::to_string(std::lround(steps_per_second)) + " steps/s";
+	if(save_status.empty() == false)
+		message += "  |  " + save_status;
+	label_message.set_text(message);
 	if(timer_running)
 		button_start_stop.set_label(labels[1]);
 	else
@@ -8,8 +8,11 @@
 #define GUI_H_INCLUDED
 
 #include "simulation.h"
+#include "trajectory.h"
 #include "tools.h"
 #include <memory>
+#include <chrono>
+#include <atomic>
 #include <gtkmm.h>
 
 /// CANVAS ///
@@ -26,11 +29,28 @@ class Canvas : public Gtk::DrawingArea{
 	public:
 		//Overridden draw method for the canvas.
 		bool on_draw(const Cairo::RefPtr<Cairo::Context>& cr) override;
+		
+		/**
+		 * Replay mode: the canvas draws the frames of a recording (trajectory.h) 
+		 * instead of the snapshots of the simulation, which is left as it is.
+		 */
+		bool start_replay(const std::string& file_path);
+		void stop_replay();
+		bool replay_mode() const;
+		const Trajectory_Replay& replay() const;	//only in replay mode
+		
+		/// shows the last frame at or before "step", returns its step
+		size_t seek(size_t step);
+		size_t replay_step() const;
   
 	private:
 		//the center coordinates of the canvas in gui's coordinate system
 		Coordinate center;
 		
+		std::unique_ptr<Trajectory_Replay> replay_;
+		Saved_State replay_frame_;
+		Render_Snapshot replay_snapshot_;
+		
 		/**
 		 * Takes a cartesian coordinate and returns a new coordinate in gui's
 		 * coordinate system.
@@ -45,9 +65,12 @@ class Canvas : public Gtk::DrawingArea{
 							 Color const& background_color = Tools::COLOR_WHITE);						  
 		void draw_border(const Cairo::RefPtr<Cairo::Context>& cr, Length thicnkess,
 						 Color const& border_color = Tools::COLOR_BLACK);
-		void draw_all_player_graphics(const Cairo::RefPtr<Cairo::Context>& cr);
-		void draw_all_rectangle_graphics(const Cairo::RefPtr<Cairo::Context>& cr);
-		void draw_all_ball_graphics(const Cairo::RefPtr<Cairo::Context>& cr);
+		void draw_all_player_graphics(Render_Snapshot const&,
+									  const Cairo::RefPtr<Cairo::Context>& cr);
+		void draw_all_rectangle_graphics(Render_Snapshot const&,
+										 const Cairo::RefPtr<Cairo::Context>& cr);
+		void draw_all_ball_graphics(Render_Snapshot const&,
+									const Cairo::RefPtr<Cairo::Context>& cr);
 		
 		/**
 		 * All the arguments given to the functions below must be the original shapes
@@ -73,6 +96,7 @@ class Gui_Window : public Gtk::Window
 	public:
 	
 		Gui_Window();
+		~Gui_Window();
 	
 	private:
 	
@@ -96,8 +120,14 @@ class Gui_Window : public Gtk::Window
 		Gtk::Button 	button_open;
 		Gtk::Button		button_save;
 		Gtk::Button		button_start_stop;
+		Gtk::ToggleButton button_fast;
 		Gtk::Button 	button_step;
+		Gtk::Button		button_step_back;
+		Gtk::ToggleButton button_replay;
 		Gtk::Label		label_message;
+		
+		//steps of the recording, shown in replay mode
+		Gtk::Scale		replay_scale;
 	
 	protected:
 		
@@ -107,17 +137,57 @@ class Gui_Window : public Gtk::Window
 		void on_button_clicked_open();
 		void on_button_clicked_save();
 		void on_button_clicked_start_stop();
+		void on_button_toggled_fast();
 		bool start_timer();
 		bool stop_timer();
 		void on_button_clicked_step();
+		void on_button_clicked_step_back();
+		void on_button_toggled_replay();
 		
 		// ===== Timer Utilites =====
 		
 		bool timer_tick();
+		bool replay_tick();
 		bool timer_running;
+		sigc::connection frame_timer;
+		
+		/**
+		 * Steps per second of the simulation thread, measured over the snapshots
+		 * drawn since rate_time.
+		 */
+		void update_step_rate(bool restart = false);
+		double steps_per_second;
+		size_t rate_steps;
+		std::chrono::steady_clock::time_point rate_time;
 		void toggle_simulation_running();
 		
 		
+		// ===== Background Save =====
+		
+		/**
+		 * Saves are written by a thread of Simulator (see save_in_background), which
+		 * reports back through save_dispatcher. save_status follows the state in 
+		 * label_message.
+		 */
+		void on_save_finished();
+		Glib::Dispatcher save_dispatcher;
+		std::atomic<bool> save_succeeded;
+		std::string save_path;
+		std::string save_status;
+		
+		
+		// ===== Replay =====
+		
+		/**
+		 * In replay mode the timer plays the recording (one step per DELTA_T, 
+		 * replay_fast_steps in fast mode) and Step shows the next step, both through 
+		 * replay_scale which can also be dragged to any step.
+		 */
+		void on_replay_scale_changed();
+		void advance_replay(size_t nb_steps);
+		std::string ask_replay_file();
+		
+		
 		// ===== Utility Methods =====
 		
 		void add_button_panel_components();
@@ -17,10 +17,10 @@
 
 void Map::initialise_map(size_t nbCell) {
 	nb_obstacles_ = 0;
-	grid_ = Grid(nbCell); 
+	obstacles_.clear();
+	arrays_outdated_ = true;
+	grid_.assign(Tools::mask_words(nbCell * nbCell), 0);
 	size_ = nbCell;
-	for(auto& col: grid_)
-		col.resize(nbCell);
 }
 
 // ===== Accessors & Manipulators ===== ///
@@ -33,13 +33,13 @@ size_t Map::nb_obstacles() const {return nb_obstacles_;}
 bool Map::is_free(size_t line, size_t col) const {
 	assert(line < size_ && col < size_);	// parameter test, for debug
 	
-	return grid_[line][col] == Cell::FREE;
+	return !Tools::mask_test(grid_.data(), line * size_ + col);
 }
 
 bool Map::is_obstacle(size_t line, size_t col) const {
 	assert(line < size_ && col < size_);	// parameter test, for debug
 	
-	return grid_[line][col] == Cell::OBSTACLE;
+	return Tools::mask_test(grid_.data(), line * size_ + col);
 }
 
 const Rectangle& Map::obstacle_body(size_t line, size_t col) const {
@@ -53,13 +53,27 @@ const Rectangle_map& Map::obstacle_bodies() const {
 	return obstacles_;
 }
 
+const std::vector<Mask_Word>& Map::obstacle_bitmap() const {return grid_;}
+
+const Rectangle_Arrays& Map::obstacle_arrays() const {
+	if(arrays_outdated_)
+		update_obstacle_arrays();
+	return obstacle_arrays_;
+}
+
+const std::pair<size_t, size_t>& Map::obstacle_key(size_t index) const {
+	if(arrays_outdated_)
+		update_obstacle_arrays();
+	return obstacle_keys_[index];
+}
+
 // ===== Utility methods =====
 
 void Map::add_obstacle(size_t line, size_t col) {
 	assert(line < size_ && col < size_);	// parameter tests, for debug
 	assert(is_free(line, col));
 	
-	grid_[line][col] = Cell::OBSTACLE;
+	Tools::mask_set(grid_.data(), line * size_ + col);
 	create_obstacle(line,col);
 	
 	nb_obstacles_++;
@@ -69,7 +83,7 @@ void Map::remove_obstacle(size_t line, size_t col) {
 	assert(line < size_ && col < size_);	// parameter tests, for debug
 	assert(is_obstacle(line,col));
 	
-	grid_[line][col] = Cell::FREE;
+	Tools::mask_reset(grid_.data(), line * size_ + col);
 	destroy_obstacle(line,col);
 	
 	nb_obstacles_--;
@@ -85,8 +99,20 @@ void Map::create_obstacle(size_t line, size_t col) {
 	double bottom_left_y = DIM_MAX - (line+1)*rectangle_side;
 	Rectangle rect({bottom_left_x, bottom_left_y}, rectangle_side, rectangle_side);
 	obstacles_.emplace(std::make_pair(line, col), rect);
+	arrays_outdated_ = true;
 }
 
 void Map::destroy_obstacle(size_t line, size_t col) {
 	obstacles_.erase(std::make_pair(line ,col));
+	arrays_outdated_ = true;
+}
+
+void Map::update_obstacle_arrays() const {
+	obstacle_arrays_.clear();
+	obstacle_keys_.clear();
+	for(const auto& obstacle : obstacles_) {
+		obstacle_arrays_.push_back(obstacle.second);
+		obstacle_keys_.push_back(obstacle.first);
+	}
+	arrays_outdated_ = false;
 }
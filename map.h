@@ -19,33 +19,29 @@
  */
 typedef std::map<std::pair<size_t, size_t>, Rectangle> Rectangle_map;
 
-/// ===== ENUM ===== ///
-
-/**
- * A cell is either empty or occupied by an obstacle. Enum class is preferred 
- * to ensure each cell is given a value corresponding to its state 
- * (not any arbitrary boolean).
- * 
- */  
-enum class Cell : bool{
-	FREE,
-	OBSTACLE
-};
-// We need first the enum declaration to define this type
-typedef std::vector<std::vector<Cell>> Grid; 
-
-
 /// ===== MAP ===== ///
 
 class Map{
 	private:
-		Grid grid_;							
+		/**
+		 * Grid of cells as a bitmap (same words as the masks of Tools): bit 
+		 * line * size_ + col is set if the cell holds an obstacle.
+		 */
+		std::vector<Mask_Word> grid_;
 		Rectangle_map obstacles_;	// geometrical representations of obstacles
 		
 		size_t size_;				// This is memorised to eliminiate the -
 									//  need to compute grid.size() every time
 		size_t nb_obstacles_;
 		
+		/**
+		 * Copy of "obstacles_" as arrays (same order) for the batch kernels of Tools.
+		 * Rebuilt lazily on first access after a modification.
+		 */
+		mutable Rectangle_Arrays obstacle_arrays_;
+		mutable std::vector<std::pair<size_t, size_t>> obstacle_keys_;
+		mutable bool arrays_outdated_;
+		
 	public:
 	
 		// ===== Initialiser =====
@@ -63,6 +59,13 @@ class Map{
 		bool is_obstacle(size_t line, size_t col) const; 
 		const Rectangle& obstacle_body(size_t, size_t) const;
 		const Rectangle_map& obstacle_bodies() const;
+		const std::vector<Mask_Word>& obstacle_bitmap() const;
+		
+		/**
+		 * Element i of the arrays is the obstacle at (line, col) = obstacle_key(i).
+		 */
+		const Rectangle_Arrays& obstacle_arrays() const;
+		const std::pair<size_t, size_t>& obstacle_key(size_t index) const;
 		
 		// ===== Utilities
 		
@@ -76,6 +79,7 @@ class Map{
 		 */
 		void create_obstacle(size_t line, size_t col);
 		void destroy_obstacle(size_t, size_t);
+		void update_obstacle_arrays() const;
 		
 };
 
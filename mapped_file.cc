@@ -0,0 +1,58 @@
+/**
+ * file: mapped_file.cc
+ * 
+ * authors:	Cem Keske
+ * 			Emre Yazici
+ */
+#include "mapped_file.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+/// ===== MAPPED FILE ===== ///
+
+
+// ===== Constructor / Destructor =====
+
+/**
+ * Only regular files can be mapped. The descriptor isn't needed once the mapping 
+ * exists.
+ */
+Mapped_File::Mapped_File(const std::string& file_path) : data_(nullptr), size_(0),
+														 open_(false) {
+	int descriptor(open(file_path.c_str(), O_RDONLY));
+	if(descriptor < 0) return;
+	
+	struct stat status;
+	if(fstat(descriptor, &status) == 0 && S_ISREG(status.st_mode)) {
+		size_ = status.st_size;
+		if(size_ == 0) {
+			open_ = true;
+		} else {
+			void* mapping(mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, descriptor, 0));
+			if(mapping != MAP_FAILED) {
+				madvise(mapping, size_, MADV_SEQUENTIAL);
+				data_ = static_cast<const char*>(mapping);
+				open_ = true;
+			}
+		}
+	}
+	close(descriptor);
+	if(open_ == false) size_ = 0;
+}
+
+Mapped_File::~Mapped_File() {
+	if(data_ != nullptr)
+		munmap(const_cast<char*>(data_), size_);
+}
+
+// ===== Accessors =====
+
+bool Mapped_File::is_open() const {return open_;}
+
+const char* Mapped_File::data() const {return data_;}
+
+const char* Mapped_File::end() const {return data_ + size_;}
+
+size_t Mapped_File::size() const {return size_;}
@@ -0,0 +1,44 @@
+/**
+ * file: mapped_file.h
+ * 
+ * authors:	Cem Keske
+ * 			Emre Yazici
+ */
+#ifndef MAPPED_FILE_H_INCLUDED
+#define MAPPED_FILE_H_INCLUDED
+
+#include <string>
+#include <cstddef>
+
+/// MAPPED FILE ///
+/**
+ * Read-only view of a whole file mapped in memory (mmap). The data is read by the 
+ * system on first access, without copy to a buffer of the program. An empty file is
+ * open with a null data().
+ */
+class Mapped_File {
+	
+	private:
+		const char* data_;
+		size_t size_;
+		bool open_;
+	
+	public:
+		
+		// ===== Constructor / Destructor =====
+		
+		explicit Mapped_File(const std::string& file_path);
+		~Mapped_File();
+		
+		Mapped_File(const Mapped_File&) = delete;
+		Mapped_File& operator=(const Mapped_File&) = delete;
+		
+		// ===== Accessors =====
+		
+		bool is_open() const;
+		const char* data() const;
+		const char* end() const;
+		size_t size() const;
+};
+
+#endif
@@ -48,7 +48,7 @@ void Player::position(const Coordinate& position) {
 }
 
 void Player::direction(const Vector& direction) {
-	if(direction.length() == 1.)
+	if(direction.length_squared() == 1.)
 		direction_ = direction;
 	else
 		direction_= direction.get_unit();
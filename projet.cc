@@ -28,18 +28,28 @@
 #include <algorithm>
 #include <memory>
 #include <iostream>
+#include <fstream>
+#include <chrono>
 #include "define.h"
 #include "simulation.h"
+#include "ensemble.h"
+#include "trajectory.h"
 #include "gui.h"
 
 /// ===== CONSTANTS ===== ///
 
 static constexpr int NO_CMDLINE_ARGUMENT(1);
-static constexpr int NB_MAX_PARAM(2);	//nb of maximum possible parameters
-										//for now we have only "Error" implemented
+static constexpr int NB_MAX_PARAM(9);	//nb of maximum possible parameters
 static constexpr int NB_IO_FILES(2);
+static constexpr size_t DEFAULT_NB_STEPS(1000);	//when no step count is given
 static const std::array<std::string, 
-						NB_MAX_PARAM> POSSIBLE_PARAMETERS = {"Error", "Step"};
+						NB_MAX_PARAM> POSSIBLE_PARAMETERS = {"Error", "Step",
+															 "Validate", "Run",
+															 "Batch", "Ensemble",
+															 "Convert", "Record",
+															 "Dump"};
+static const std::string FINAL_STATE_SUFFIX("_final");	//output files of "Batch"
+static const std::array<std::string, 3> IO_FORMATS = {".txt", ".snap", ".traj"};
 
 /// ===== FUNCTION DECLARATIONS ===== ///
 
@@ -47,7 +57,21 @@ static void read_cmd_args(int, char*[],
 						  std::vector<std::string>&, std::vector<std::string>&);
 static void init_execution_parameters(std::vector<std::string> const&, 
 									  std::unordered_map<std::string, bool>&);
+static size_t read_nb_steps(std::vector<std::string> const&);
+static std::vector<size_t> read_numbers(std::vector<std::string> const&);
+static void read_nb_threads(std::vector<std::string> const&);
 static int open_gui();
+static void validate(std::vector<std::string> const& io_files, size_t nb_steps);
+static void run_batch(std::vector<std::string> const& io_files, size_t nb_steps);
+static void run_simulations(std::vector<std::string> const& input_files, 
+							size_t nb_steps);
+static std::string final_state_path(const std::string& input_file);
+static void run_ensemble(std::vector<std::string> const& io_files);
+static void convert(std::vector<std::string> const& io_files);
+static void record(std::vector<std::string> const& io_files, size_t nb_steps);
+static void dump(std::vector<std::string> const& io_files, 
+				 std::vector<size_t> const& steps);
+static std::string frame_path(const std::string& output_file, size_t step);
 
 /// ===== MAIN FUNCTION ===== ///
 
@@ -55,13 +79,22 @@ int main(int argc, char* argv[]) {
 	
 	std::vector<std::string> io_files;
 	std::unordered_map<std::string, bool> execution_parameters;
+	size_t nb_steps(DEFAULT_NB_STEPS);
+	std::vector<size_t> numbers;	//all numeric parameters ("Dump")
 
 	{
 	std::vector<std::string> cmd_parameters;
 	read_cmd_args(argc, argv, cmd_parameters, io_files);
 	init_execution_parameters(cmd_parameters, execution_parameters);
+	nb_steps = read_nb_steps(cmd_parameters);
+	numbers = read_numbers(cmd_parameters);
+	read_nb_threads(cmd_parameters);
 	}	//cmd_parameters' lifetime expired, we don't need it anymore
 	
+	// only "Batch" takes more than an input and an output file
+	if(execution_parameters["Batch"] == false && io_files.size() > NB_IO_FILES)
+		io_files.resize(NB_IO_FILES);
+	
 	// initialize execution parameters in Simulator
 	Simulator::exec_parameters(execution_parameters);
 	
@@ -73,6 +106,20 @@ int main(int argc, char* argv[]) {
 		} else {
 			std::cout << "No I/O file. Aborting... " << std::endl; 
 		}
+	} else if (execution_parameters["Validate"] == true) {
+		validate(io_files, nb_steps);
+	} else if (execution_parameters["Run"] == true) {
+		run_batch(io_files, nb_steps);
+	} else if (execution_parameters["Batch"] == true) {
+		run_simulations(io_files, nb_steps);
+	} else if (execution_parameters["Ensemble"] == true) {
+		run_ensemble(io_files);
+	} else if (execution_parameters["Convert"] == true) {
+		convert(io_files);
+	} else if (execution_parameters["Record"] == true) {
+		record(io_files, nb_steps);
+	} else if (execution_parameters["Dump"] == true) {
+		dump(io_files, numbers);
 	} else if (io_files.size() > 0) {
 		Simulator::create_simulation(io_files);
 		open_gui();
@@ -85,7 +132,8 @@ int main(int argc, char* argv[]) {
 /// ===== FUNCTION DEFINITIONS ===== ///
 
 /** 
- * Reads command line arguments from args and sets "io_files" with given .txt files and
+ * Reads command line arguments from args and sets "io_files" with given .txt, .snap
+ * (binary snapshot) or .traj (trajectory) files and
  * "cmd_parameters" with given execution parameters.
  */
 static void read_cmd_args(int argc, char* argv[], 
@@ -95,17 +143,18 @@ static void read_cmd_args(int argc, char* argv[],
 	if(argc == NO_CMDLINE_ARGUMENT) return;	//no need to read args if there are none
 	unsigned int nb_parameters(argc);
 	
-	unsigned int io_counter(0);	//counts io parameters
 	bool io_format_found(false);
 
 	std::string argv_param;
 	
 	for(size_t i(1); i<nb_parameters; ++i) {	// argv[0] is not relevant
 		argv_param = argv[i];
-		io_format_found = argv_param.find(".txt") != std::string::npos;
-		if(io_format_found && io_counter < NB_IO_FILES) {
+		io_format_found = std::any_of(IO_FORMATS.begin(), IO_FORMATS.end(), 
+									  [&argv_param](const std::string& format) {
+			return argv_param.find(format) != std::string::npos;
+		});
+		if(io_format_found) {
 			io_files.push_back(argv[i]);
-			++io_counter;
 		} else {
 			cmd_parameters.push_back(argv_param);
 		}
@@ -131,6 +180,251 @@ static void init_execution_parameters(std::vector<std::string> const &cmd_parame
 	}
 }
 
+/**
+ * A purely numeric parameter is the number of steps to run (used by "Validate" and
+ * "Run").
+ */
+static size_t read_nb_steps(std::vector<std::string> const &cmd_parameters) {
+	for(const auto &param : cmd_parameters) {
+		if(!param.empty() && std::all_of(param.begin(), param.end(), ::isdigit))
+			return std::stoul(param);
+	}
+	return DEFAULT_NB_STEPS;
+}
+
+static std::vector<size_t> read_numbers(std::vector<std::string> const &cmd_parameters) {
+	std::vector<size_t> numbers;
+	for(const auto &param : cmd_parameters) {
+		if(!param.empty() && std::all_of(param.begin(), param.end(), ::isdigit))
+			numbers.push_back(std::stoul(param));
+	}
+	return numbers;
+}
+
+/**
+ * "-jN" runs the simulations on N threads (default: one per hardware thread).
+ */
+static void read_nb_threads(std::vector<std::string> const &cmd_parameters) {
+	for(const auto &param : cmd_parameters) {
+		if(param.size() > 2 && param.compare(0, 2, "-j") == 0 &&
+		   std::all_of(param.begin() + 2, param.end(), ::isdigit)) {
+			Simulator::nb_threads(std::stoul(param.substr(2)));
+			return;
+		}
+	}
+}
+
+/**
+ * Usage: ./projet Validate input.txt trajectory.txt [nb_steps]
+ * 
+ * If "trajectory.txt" doesn't exist yet, the trajectory of this build is written to 
+ * it (do this with the default double build). Otherwise this build's trajectory is
+ * compared to it (do this with a SCALAR=float build, or other compiler flags).
+ */
+static void validate(std::vector<std::string> const& io_files, size_t nb_steps) {
+	if(io_files.size() < NB_IO_FILES) {
+		std::cout << "Validation needs an input and a trajectory file." << std::endl;
+		return;
+	}
+	if(Simulator::create_simulation(io_files) == false) return;
+	
+	if(std::ifstream(io_files.back()).good()) {
+		Simulator::compare_trajectory(io_files.back(), nb_steps);
+	} else if(Simulator::write_trajectory(io_files.back(), nb_steps)) {
+		std::cout << "Reference trajectory written to " << io_files.back() 
+				  << std::endl;
+	}
+}
+
+/**
+ * Usage: ./projet Run input.txt [output.txt] [nb_steps]
+ * 
+ * Runs the simulation without gui for "nb_steps" steps or until the game stops, then
+ * saves the final state to the last given file (like "Step" does).
+ */
+static void run_batch(std::vector<std::string> const& io_files, size_t nb_steps) {
+	if(io_files.empty()) {
+		std::cout << "No I/O file. Aborting... " << std::endl;
+		return;
+	}
+	if(Simulator::create_simulation(io_files) == false) return;
+	
+	if(Simulator::run_batch(io_files.back(), nb_steps) == false)
+		std::cout << "Could not save to " << io_files.back() << std::endl;
+}
+
+/**
+ * Usage: ./projet Batch input1.txt input2.txt ... [nb_steps]
+ * 
+ * Loads one simulation per input file and runs them all in parallel without gui for
+ * "nb_steps" steps or until they stop. The final state of "input.txt" is saved to 
+ * "input_final.txt".
+ */
+static void run_simulations(std::vector<std::string> const& input_files, 
+							size_t nb_steps) {
+	std::vector<std::string> loaded_files;
+	for(const auto& input_file : input_files) {
+		if(Simulator::add_simulation({input_file}))
+			loaded_files.push_back(input_file);
+	}
+	if(loaded_files.empty()) {
+		std::cout << "No simulation loaded. Aborting... " << std::endl;
+		return;
+	}
+	
+	auto start(std::chrono::steady_clock::now());
+	Simulator::run_all_sims(nb_steps);
+	std::chrono::duration<double> wall_time(std::chrono::steady_clock::now() - start);
+	
+	static const std::array<std::string, GAME_OVER + 1> state_names = {
+		"no game", "running", "player trapped", "game over"};
+	size_t total_steps(0);
+	
+	for(size_t i(0); i < loaded_files.size(); ++i) {
+		total_steps += Simulator::simulation_steps(i);
+		std::cout << loaded_files[i] << ": " << state_names[Simulator::simulation_state(i)]
+				  << ", " << Simulator::simulation_steps(i) << " steps, " 
+				  << Simulator::simulation_players(i) << " players, "
+				  << Simulator::simulation_balls(i) << " balls" << std::endl;
+		Simulator::save_simulation(i, final_state_path(loaded_files[i]));
+	}
+	std::cout << loaded_files.size() << " simulations, " << total_steps 
+			  << " steps in " << wall_time.count() << " s";
+	if(wall_time.count() > 0)
+		std::cout << " (" << total_steps / wall_time.count() << " steps/s)";
+	std::cout << std::endl;
+	Simulator::print_thread_statistics();
+}
+
+/**
+ * "dir/input.txt" gives "dir/input_final.txt" (same for ".snap")
+ */
+static std::string final_state_path(const std::string& input_file) {
+	std::string path(input_file);
+	return path.insert(path.rfind('.'), FINAL_STATE_SUFFIX);
+}
+
+/**
+ * Usage: ./projet Ensemble sweep.txt
+ * 
+ * Runs the scenarios of "sweep.txt" with all the parameter sets it describes and 
+ * writes the aggregated results to a csv file (see ensemble.h for the format).
+ */
+static void run_ensemble(std::vector<std::string> const& io_files) {
+	if(io_files.empty()) {
+		std::cout << "No sweep file. Aborting... " << std::endl;
+		return;
+	}
+	Ensemble ensemble;
+	if(ensemble.read_spec(io_files[0]) == false) return;
+	
+	auto start(std::chrono::steady_clock::now());
+	ensemble.run();
+	std::chrono::duration<double> wall_time(std::chrono::steady_clock::now() - start);
+	
+	std::cout << ensemble.nb_runs() << " runs in " << wall_time.count() << " s" 
+			  << std::endl;
+	Simulator::print_thread_statistics();
+	if(ensemble.write_csv(ensemble.output_path()))
+		std::cout << "Results written to " << ensemble.output_path() << std::endl;
+	else
+		std::cout << "Could not write " << ensemble.output_path() << std::endl;
+}
+
+/**
+ * Usage: ./projet Convert input.txt output.snap (or input.snap output.txt)
+ * 
+ * Loads the input file and saves it in the format of the output file, which is given
+ * by its extension. The state is checked like for any other loading.
+ */
+static void convert(std::vector<std::string> const& io_files) {
+	if(io_files.size() < NB_IO_FILES) {
+		std::cout << "Conversion needs an input and an output file." << std::endl;
+		return;
+	}
+	if(Simulator::create_simulation({io_files.front()}) == false) return;
+	
+	if(Simulator::save_simulation(0, io_files.back()))
+		std::cout << "Converted to " << io_files.back() << std::endl;
+	else
+		std::cout << "Could not save to " << io_files.back() << std::endl;
+}
+
+/**
+ * Usage: ./projet Record input.txt output.traj [nb_steps]
+ * 
+ * Runs the simulation without gui like "Batch" and writes its state after each step 
+ * to "output.traj" (see trajectory.h).
+ */
+static void record(std::vector<std::string> const& io_files, size_t nb_steps) {
+	if(io_files.size() < NB_IO_FILES || 
+	   Trajectory::is_trajectory_path(io_files.back()) == false) {
+		std::cout << "Recording needs an input and a .traj file." << std::endl;
+		return;
+	}
+	if(Simulator::create_simulation({io_files.front()}) == false) return;
+	if(Simulator::start_recording(io_files.back()) == false) {
+		std::cout << "Could not write " << io_files.back() << std::endl;
+		return;
+	}
+	
+	auto start(std::chrono::steady_clock::now());
+	Simulator::run_all_sims(nb_steps);
+	bool success(Simulator::stop_recording());
+	std::chrono::duration<double> wall_time(std::chrono::steady_clock::now() - start);
+	
+	std::cout << Simulator::simulation_steps(0) << " steps recorded in " 
+			  << wall_time.count() << " s";
+	if(success == false)
+		std::cout << ", writing " << io_files.back() << " failed";
+	std::cout << std::endl;
+}
+
+/**
+ * Usage: ./projet Dump recording.traj output.txt [step ...]
+ * 
+ * Writes the frames of the given steps (the last frame if none is given) to 
+ * "output_<step>.txt", or .snap files for a .snap output. A step that wasn't recorded
+ * gives the last frame before it. Positions and angles are those of the recording,
+ * thus quantised.
+ */
+static void dump(std::vector<std::string> const& io_files, 
+				 std::vector<size_t> const& steps) {
+	if(io_files.size() < NB_IO_FILES) {
+		std::cout << "Dump needs a .traj file and an output file." << std::endl;
+		return;
+	}
+	Trajectory_Replay replay(io_files.front());
+	if(replay.is_valid() == false) {
+		std::cout << io_files.front() << " is not a trajectory file." << std::endl;
+		return;
+	}
+	
+	std::vector<size_t> frames;
+	for(size_t step : steps)
+		frames.push_back(replay.frame_index(step));
+	if(frames.empty())
+		frames.push_back(replay.nb_frames() - 1);
+	
+	Saved_State frame;
+	for(size_t index : frames) {
+		std::string path(frame_path(io_files.back(), replay.frame_step(index)));
+		if(replay.frame(index, frame) && Simulator::write_state(frame, path))
+			std::cout << "Step " << replay.frame_step(index) << " written to " 
+					  << path << std::endl;
+		else
+			std::cout << "Could not save to " << path << std::endl;
+	}
+}
+
+/**
+ * "dir/frame.txt" gives "dir/frame_<step>.txt"
+ */
+static std::string frame_path(const std::string& output_file, size_t step) {
+	std::string path(output_file);
+	return path.insert(path.rfind('.'), "_" + std::to_string(step));
+}
+
 static int open_gui() {
 	auto app = Gtk::Application::create();
 		
@@ -10,6 +10,13 @@
 #include "player.h"
 #include "map.h"
 #include "ball.h"
+#include "arena.h"
+#include "thread_pool.h"
+#include "tiles.h"
+#include "triple_buffer.h"
+#include "mapped_file.h"
+#include "snapshot.h"
+#include "trajectory.h"
 #include "assert.h"
 #include <fstream>
 #include <iostream>
@@ -18,6 +25,15 @@
 #include <array>
 #include <cmath>
 #include <algorithm>
+#include <iomanip>
+#include <limits>
+#include <chrono>
+#include <functional>
+#include <charconv>
+#include <iterator>
+#include <cctype>
+#include <cstring>
+#include <type_traits>
 
 typedef uint64_t Floyd_Dist;
 typedef std::vector<std::vector<Floyd_Dist>> Floyd_Matrix;
@@ -32,6 +48,161 @@ typedef std::pair<size_t, size_t> Index_Pair ;
 static constexpr Floyd_Dist dist_coefficient(100000);
 static constexpr Floyd_Dist sqrt2_const(141421);
 
+static constexpr size_t neighbor_number(8);	//cells around a cell
+static constexpr size_t max_hits_per_ball(4);	//players around a ball, see reserve()
+static constexpr size_t min_players_per_chunk(32);	//smaller games run on one thread
+static constexpr size_t floyd_rows_per_task(8);
+static constexpr size_t min_players_for_tiles(128);
+static constexpr size_t cells_per_tile(4);
+static constexpr double fast_frame_budget(1./60);	//seconds of steps per snapshot
+static constexpr double horizon_slack(1e-6);	//for rounding, relative to SIDE
+static constexpr double simultaneous_impacts(1e-9);	//fraction of a step
+static constexpr size_t writer_buffer_size(1 << 16);	//bytes written at once
+static constexpr size_t max_number_chars(32);	//longest number File_Writer writes
+static constexpr int save_precision(6);	//significant digits of the text format
+static constexpr size_t rewind_capacity(64);	//copies kept for Simulator::step_back
+static constexpr size_t rewind_interval(16);	//steps between two copies
+static constexpr double max_flight_steps(1 << 14);	//reserved flight of a slow ball
+
+
+/// ===== STEP COMMANDS ===== class declaration ///
+
+/**
+ * A ball to be created at the end of the step.
+ */
+struct Ball_Spawn {
+	Coordinate position;
+	Vector direction;
+};
+
+/**
+ * Structural changes (ball spawns, hits on players, obstacle removals, deaths) are 
+ * not applied while the step is computed: they are recorded here and applied in one 
+ * batch at the end of Simulation::update. This way the collision passes only read
+ * the state of the simulation, and several obstacles removed in the same step cost
+ * a single rebuild of the floyd matrix.
+ */
+class Step_Commands {
+	
+	private:
+		std::vector<Ball_Spawn> spawns_;
+		std::vector<std::vector<Ball_Spawn>> spawn_buffers_;	//one per chunk
+		std::vector<size_t> hits_;					//player index, once per hit
+		std::vector<Index_Pair> obstacle_removals_;	//may contain duplicates
+		std::vector<size_t> deaths_;				//player index
+	
+	public:
+		
+		// ===== Accessors =====
+		
+		const std::vector<Ball_Spawn>& spawns() const;
+		const std::vector<size_t>& hits() const;
+		const std::vector<Index_Pair>& obstacle_removals() const;
+		const std::vector<size_t>& deaths() const;
+		bool empty() const;
+		
+		// ===== Recorders =====
+		
+		void spawn(Coordinate const& position, Vector const& direction);
+		void hit(size_t player_index);
+		
+		/**
+		 * Spawns recorded in parallel: each chunk of players records in its own 
+		 * buffer, the buffers are then appended to the spawns in chunk order. The 
+		 * spawns stay ordered by player index.
+		 */
+		void open_spawn_buffers(size_t nb_chunks);
+		std::vector<Ball_Spawn>& spawn_buffer(size_t chunk);
+		void merge_spawn_buffers();
+		void remove_obstacle(Index_Pair const& obstacle);
+		void death(size_t player_index);
+		
+		// ===== Methods =====
+		
+		void reserve(size_t nb_balls, size_t nb_players, size_t nb_obstacles);
+		void clear();
+		
+		/// sorts the obstacle removals and drops duplicates
+		void unique_obstacle_removals();
+};
+
+
+/**
+ * Player j (j < i) that may block the move of player i, depending on whether j moved
+ * before i in the same step (see Simulation::update_player_positions).
+ */
+struct Move_Candidate {
+	size_t player_index;
+	bool blocks_if_still;	//i touches the position of j before its move
+	bool blocks_if_moved;	//i touches the position of j after its move
+};
+
+/**
+ * Work memory of one tile in the tiled player phases, kept from one step to the next.
+ * The players seen by the tile are its owned players followed by its ghosts.
+ */
+struct Tile_Scratch {
+	std::vector<size_t> players;
+	Circle_Arrays before_move;
+	Circle_Arrays after_move;
+	std::vector<Mask_Word> masks;
+	std::vector<Move_Candidate> candidates;
+};
+
+
+/// ===== REWIND RING ===== class declaration ///
+
+/**
+ * Copy of a simulation for the rewind (see Simulator::step_back). Unlike Saved_State
+ * it holds the players and balls as they are (exact directions of the balls), so the
+ * steps run again from it give the same simulation as the first time.
+ */
+struct Rewind_Snapshot {
+	size_t nb_steps = 0;
+	size_t nb_obstacles_destroyed = 0;
+	Simulation_State state = NO_GAME;
+	std::vector<Player> players;
+	std::vector<Ball> balls;
+	std::vector<Mask_Word> obstacles;	//bitmap of Map
+};
+
+/**
+ * The last rewind_capacity copies of the active simulation, in the order of their 
+ * steps. The slots are reused with the capacity of their vectors, so that once the
+ * ring is full a copy is only a copy of arrays and the memory doesn't grow.
+ */
+class Rewind_Ring {
+	
+	private:
+		std::vector<Rewind_Snapshot> slots_;
+		size_t first_;		//oldest copy
+		size_t size_;
+	
+	public:
+		
+		// ===== Constructor =====
+		
+		Rewind_Ring();
+		
+		// ===== Methods =====
+		
+		void clear();
+		
+		/// slot of a new copy, the oldest one is dropped when the ring is full
+		Rewind_Snapshot& push();
+		
+		/// last copy at or before "nb_steps", nullptr if there is none
+		const Rewind_Snapshot* find(size_t nb_steps) const;
+		
+		/// drops the copies after "nb_steps", before the steps are run again
+		void drop_after(size_t nb_steps);
+	
+	private:
+		
+		Rewind_Snapshot& slot(size_t age_index);	//0: oldest copy
+		const Rewind_Snapshot& slot(size_t age_index) const;
+};
+
 
 /// ===== SIMULATION ===== class declaration ///
 
@@ -49,6 +220,8 @@ class Simulation {
 		Length marge_lecture_;
 		Counter player_cooldown_per_t_;
 		
+		Simulation_Parameters parameters_;
+		
 		Simulation_State state_;
 		
 		bool success_;
@@ -67,11 +240,54 @@ class Simulation {
 		vec_ball_bodies ball_bodies_;		
 		vec_obstacle_bodies obstacle_bodies_;		
 		
+		/**
+		 * Per step scratch for the batch collision kernels. Kept as members so that 
+		 * their capacity is reused from one step to the next.
+		 */
+		Circle_Arrays player_circles_;
+		Circle_Arrays ball_circles_;
+		std::vector<Coordinate> player_starts_;	//before the moves (swept balls)
+		std::vector<size_t> hit_candidates_;		//players near a swept ball
+		
+		/**
+		 * Per player, last step at which its target search (target_kept_until_) and
+		 * its collision test with the other players (free_until_) can be skipped. 
+		 * See update_player_targets.
+		 */
+		std::vector<size_t> target_kept_until_;
+		std::vector<size_t> free_until_;
+		
+		/**
+		 * Decomposition of the arena in tiles of cells for big games (see 
+		 * move_players_in_tiles). player_tiles_ holds the players at the cells they 
+		 * had before the moves of the current step.
+		 */
+		Tile_Grid player_tiles_;
+		std::vector<Tile_Scratch> tile_scratch_;
+		bool tiles_active_;
+		
+		/// temporaries of the current step (masks, neighbor lists ...)
+		Frame_Arena frame_arena_;
+		
+		/// structural changes of the current step
+		Step_Commands commands_;
+		
+		size_t nb_steps_;
+		size_t nb_quiet_steps_;
+		size_t nb_obstacles_destroyed_;
+		
+		/// writes every step to a trajectory file while it exists (trajectory.h)
+		std::unique_ptr<Trajectory_Recorder> recorder_;
+		
 	public:
 	
 		// ===== Constructor =====
 		
-		Simulation(std::vector<std::string> const&);
+		Simulation(std::vector<std::string> const&, 
+				   Simulation_Parameters const& = Simulation_Parameters());
+		
+		/// reads the simulation from "in_data" (input file format)
+		Simulation(std::istream& in_data, Simulation_Parameters const&);
 		
 		
 		// ===== Public Methods =====
@@ -80,6 +296,9 @@ class Simulation {
 		void state(Simulation_State);
 		
 		bool success() const;
+		size_t nb_steps() const;	//steps run since the simulation was loaded
+		size_t nb_obstacles_destroyed() const;
+		const Simulation_Parameters& parameters() const;
 		
 		const std::vector<Player>& players() const;
 		const std::vector<Ball>& balls() const;
@@ -88,6 +307,7 @@ class Simulation {
 		void nb_cells(size_t);
 		bool initialise_player(double, double, Counter, Counter);
 		bool initialise_ball(double, double, Angle);
+		bool initialise_ball(Coordinate const&, Vector const& direction);
 		void initialise_dimensions(size_t);
 	
 		//signed input to test negative values. counter is for error report.
@@ -106,14 +326,45 @@ class Simulation {
 		
 		void update(double delta_t);
 		void update_graphics();
+		void fill_snapshot(Render_Snapshot&) const;
+		
+		/// advances one step without refreshing the graphics (headless runs)
+		void step(double delta_t);
+		
+		/**
+		 * Runs up to "nb_steps" steps like step() (fewer if the game stops) and 
+		 * returns the number run. Stretches where only the players move are run as
+		 * quiet steps, see quiet_horizon.
+		 */
+		size_t advance(size_t nb_steps);
+		size_t nb_quiet_steps() const;
 		
 		
 		// ===== Utilities =====
 		
 		bool is_over() const;		
+		
+		/// text format, or binary snapshot format for ".snap" paths (snapshot.h)
 		bool save(const std::string &o_file_path) const;
+		void save_state(Saved_State&) const;
+		Snapshot::Player_Record player_record(size_t index) const;
+		Snapshot::Ball_Record ball_record(size_t index) const;
+		
+		/// the current state, then the state after each step
+		bool start_recording(const std::string &o_file_path);
+		bool stop_recording();	//false if a write failed
+		
+		/// exact copy for the rewind, restore() fails while recording
+		void save_rewind(Rewind_Snapshot&) const;
+		bool restore(Rewind_Snapshot const&);
+		
+		/// one line with the counts, then one line per player and per ball
+		void write_positions(std::ostream&) const;
+		std::vector<Coordinate> positions() const;	//players then balls
 		
 	private:
+		
+		void initialise_fields(Simulation_Parameters const&);
 				
 		bool test_center_position(double x,double y) const;
 		bool detect_all_ball_player_collisions() const;
@@ -133,34 +384,192 @@ class Simulation {
 		Coordinate player_floyd_target(const Player&, bool&); 
 		Coordinate get_cell_center(size_t, size_t);
 		Index_Pair get_grid_position(Coordinate const&);
-		std::vector<Index_Pair> obstacles_around(size_t x1, size_t y1);
+		size_t obstacles_around(size_t x1, size_t y1, Index_Pair* obstacles);
 		
 		void update_player_targets();
 		void update_player_directions();
 		void update_player_positions();
+		void move_players_in_order(Vector const* moves);
+		void move_players_in_tiles(Vector const* moves);
+		void update_player_tiles();
+		Index_Pair get_clamped_grid_position(Coordinate const&);
 		void update_ball_positions();
 		void perform_player_actions();
+		void finish_step();
+		
+		size_t quiet_horizon(size_t max_steps) const;
+		bool quiet_step();
+		void record_step();
 		
 		void update_player_graphics();
 		void update_ball_bodies(); 
 		void update_obstacle_bodies(); 
 		
 		void handle_ball_collisions();
-		void handle_ball_player_collisions(Ball& ball);
+		bool detect_ball_ball_collisions(size_t ball_index, Mask_Word* mask) const;
+		bool record_ball_player_hits(size_t ball_index, Mask_Word* mask);
+		bool record_ball_obstacle_hits(size_t ball_index, Mask_Word* mask);
+		double swept_ball_ball_impact(size_t ball_index, Mask_Word* mask) const;
+		bool record_swept_ball_hits(size_t ball_index, double ball_impact, 
+									Mask_Word* player_mask, Mask_Word* obstacle_mask);
 		void take_player_life(size_t &player_index);
 		
-		bool detect_ball_player_collision(const Ball&, const Player&);
-		bool detect_ball_ball_collision(const Ball& first, const Ball& second);
+		Mask_Word* scratch_mask(size_t nb_elements);
+		void reserve_ball_pool();
 		
+		/**
+		 * Player phases are split in contiguous chunks of players run on the thread
+		 * pool. The task gets the chunk index and its range of players.
+		 */
+		size_t nb_player_chunks() const;
+		template <typename Task>
+		void for_each_player_chunk(size_t nb_chunks, const Task& task);
+		
+		void apply_commands();
 		void remove_collided_balls();
 		void remove_dead_players();
 		void remove_out_of_bounds();
 		
-		void remove_obstacle(size_t, size_t);
+		void remove_obstacles(const std::vector<Index_Pair>&);
 
 };
 
 
+/// ===== TEXT SCANNER ===== class declaration ///
+
+/**
+ * Reads the input format in place from a buffer in memory (a mapped file or the 
+ * contents of a stream): numbers are parsed with std::from_chars, lines are not 
+ * copied. Same rules as the stream extractions it replaces: a comment line starts 
+ * with '#' after its leading whitespace, the values of a line are separated by 
+ * whitespace and anything after the values read is ignored.
+ */
+class Text_Scanner {
+	
+	private:
+		const char* position_;
+		const char* end_;
+		const char* line_end_;		//end of the current data line
+	
+	public:
+		
+		// ===== Constructor =====
+		
+		Text_Scanner(const char* begin, const char* end);
+		
+		// ===== Methods =====
+		
+		/// goes to the next line that isn't blank or a comment
+		bool next_data_line();
+		
+		/// reads values in order from the current line
+		template <typename... Values>
+		bool read(Values&... values) {
+			return (read_value(values) && ...);
+		}
+	
+	private:
+		
+		bool read_value(int&);
+		bool read_value(Counter&);
+		bool read_value(double&);
+		bool skip_to_value();
+};
+
+
+/// ===== FILE WRITER ===== class declaration ///
+
+/**
+ * Output file written through a fixed buffer: values are formatted in place with 
+ * std::to_chars and the buffer goes to the file whenever it is full, so a save needs
+ * the same memory whatever the size of the simulation. Doubles are written like the
+ * default ostream formatting (6 significant digits).
+ */
+class File_Writer {
+	
+	private:
+		std::ofstream file_;
+		std::unique_ptr<char[]> buffer_;
+		size_t used_;
+	
+	public:
+		
+		// ===== Constructor =====
+		
+		File_Writer(const std::string& file_path, std::ios::openmode mode);
+		
+		// ===== Methods =====
+		
+		bool is_open() const;
+		
+		File_Writer& operator<<(const char* text);
+		File_Writer& operator<<(double value);
+		
+		template <typename Integer, 
+				  typename = std::enable_if_t<std::is_integral<Integer>::value>>
+		File_Writer& operator<<(Integer value) {
+			reserve(max_number_chars);
+			used_ = std::to_chars(buffer_.get() + used_, 
+								  buffer_.get() + writer_buffer_size, value).ptr - 
+					buffer_.get();
+			return *this;
+		}
+		
+		/// raw bytes of trivially copyable records
+		void write(const void* data, size_t size);
+		
+		/// writes what is left in the buffer, false if any write failed
+		bool close();
+	
+	private:
+		
+		/// makes room for "size" bytes (at most writer_buffer_size)
+		void reserve(size_t size);
+		void flush();
+};
+
+
+/// ===== STATE VIEW ===== class declaration ///
+
+/**
+ * What the file writers read, as the records of the binary format (snapshot.h). A 
+ * view of a Saved_State, or of a Simulation whose records are then made one at a 
+ * time while writing: a save of the simulation itself doesn't copy it first.
+ */
+class State_View {
+	
+	private:
+		const Saved_State* saved_;		//one of the two is null
+		const Simulation* simulation_;
+		size_t nb_cells_;
+		size_t nb_obstacles_;
+		const std::vector<Mask_Word>& obstacles_;
+	
+	public:
+		
+		// ===== Constructors =====
+		
+		explicit State_View(Saved_State const&);
+		State_View(Simulation const&, size_t nb_cells, size_t nb_obstacles,
+				   const std::vector<Mask_Word>& obstacles);
+		
+		// ===== Accessors =====
+		
+		size_t nb_cells() const;
+		size_t nb_obstacles() const;
+		size_t nb_players() const;
+		size_t nb_balls() const;
+		Snapshot::Player_Record player(size_t index) const;
+		Snapshot::Ball_Record ball(size_t index) const;
+		const std::vector<Mask_Word>& obstacles() const;	//bitmap of Map
+};
+
+/// writers of the two file formats, chosen by the path (see Simulator::write_state)
+static bool write_state_file(State_View const&, const std::string& o_file_path);
+static bool write_text_file(State_View const&, const std::string& o_file_path);
+static bool write_snapshot_file(State_View const&, const std::string& o_file_path);
+
+
 /// ===== READER ===== class declaration ///
 
 /**
@@ -204,18 +613,20 @@ class Reader {
 		// ===== Public Methods =====
 		
 		bool import_file(std::string const&, Simulation&);
-		bool read_file(std::ifstream&, Simulation&,bool only_one_state = false);
+		bool import_stream(std::istream&, Simulation&);
+		bool read_file(Text_Scanner&, Simulation&,bool only_one_state = false);
 		
 	
 	private:
 		// ===== Private Static Functions =====
 		
-		/// Reads the next line in the file (provided by "istream") ignoring comments
-		static bool next_data_line(std::ifstream&, std::string&);
-		static bool read_nb_cells(std::ifstream&, Simulation&);
-		static bool read_players(std::ifstream&, Simulation&);
-		static bool read_obstacles(std::ifstream&, Simulation&);
-		static bool read_balls(std::ifstream&, Simulation&);
+		static bool read_nb_cells(Text_Scanner&, Simulation&);
+		static bool read_players(Text_Scanner&, Simulation&);
+		static bool read_obstacles(Text_Scanner&, Simulation&);
+		static bool read_balls(Text_Scanner&, Simulation&);
+		
+		/// whole simulation from the binary snapshot format (see snapshot.h)
+		bool read_snapshot(const char* data, size_t size, Simulation&);
 		static void finalise_reading(ReaderState &actual_state);
 		static void print_error_state(ReaderState); /// for debugging
 	
@@ -259,12 +670,31 @@ std::unordered_map<std::string, bool>& Simulator::execution_parameters() {
 	return execution_parameters_;
 }
 
+/**
+ * Wrapper function that contains the thread pool stepping the simulations. It is 
+ * created at first use unless nb_threads was called before.
+ */
+std::unique_ptr<Thread_Pool>& Simulator::thread_pool_holder() {
+	static std::unique_ptr<Thread_Pool> thread_pool_;
+	return thread_pool_;
+}
+
+Thread_Pool& Simulator::thread_pool() {
+	if(thread_pool_holder() == nullptr)
+		thread_pool_holder().reset(new Thread_Pool());
+	return *thread_pool_holder();
+}
+
+void Simulator::nb_threads(size_t nb_threads) {
+	thread_pool_holder().reset(new Thread_Pool(nb_threads));
+}
+
 /**
  * Wrapper function for active simulations.
- * This vector holds up to two simulation instances. During reading of a new 
- * simulation (with Open button) it will be added in this vector.
- * Note that in case of a successful reading, the new simulation object is moved to 
- * active_sims[0] and the data in the previous simulation is lost.
+ * This vector holds all the loaded simulations, stepped together by update_all_sims.
+ * add_simulation appends one, create_simulation replaces the one at 
+ * current_sim_index (the one shown by the gui) and keeps the others. A new 
+ * simulation is read next to the old ones, so a bad file leaves them untouched.
  */
 std::vector<Simulation>& Simulator::active_sims() {
 
@@ -275,8 +705,8 @@ std::vector<Simulation>& Simulator::active_sims() {
 /**
  * Creates a new simulation with give io file(s) and replaces the current sim. 
  * 
- * This function when modified in the future will enable us to implement multiple 
- * simultaneous simulations. 
+ * The other simulations are kept, use add_simulation to load more than one. On a 
+ * bad file nothing is replaced.
  */
 bool Simulator::create_simulation(std::vector<std::string> const& io_files)	{
 	
@@ -297,9 +727,26 @@ bool Simulator::create_simulation(std::vector<std::string> const& io_files)	{
 			// precedent.
 	}								
 	assert(active_sims.size()==1);
+	if(success) {
+		rewind_ring().clear();
+		active_sims()[current_sim_index()].save_rewind(rewind_ring().push());
+	}
+	publish_snapshot();
 	return success;
 }
 
+/**
+ * Loads a new simulation next to the existing ones. The active simulation (the one 
+ * shown by the gui) doesn't change unless there was none.
+ */
+bool Simulator::add_simulation(std::vector<std::string> const& io_files) {
+	Simulation simulation(io_files);
+	if(simulation.success() == false) return false;
+	
+	active_sims().push_back(std::move(simulation));
+	return true;
+}
+
 /**
  * Imports an input file path and passes the call to create a new simulation with the
  * file on given path.
@@ -313,6 +760,10 @@ bool Simulator::empty() {
 	return active_sims().empty();
 }
 
+size_t Simulator::nb_simulations() {
+	return active_sims().size();
+}
+
 /**
  * Returns the corresponding enum for the state of the active simulation.
  * The case of a player being trapped is not implemented yet.
@@ -320,7 +771,25 @@ bool Simulator::empty() {
 Simulation_State Simulator::active_simulation_state() {
 	if(active_sims().empty())
 		return NO_GAME;
-	return active_sims()[current_sim_index()].state();
+	return simulation_state(current_sim_index());
+}
+
+Simulation_State Simulator::simulation_state(size_t index) {
+	if(index >= active_sims().size())
+		return NO_GAME;
+	return active_sims()[index].state();
+}
+
+size_t Simulator::simulation_steps(size_t index) {
+	return active_sims().at(index).nb_steps();
+}
+
+size_t Simulator::simulation_players(size_t index) {
+	return active_sims().at(index).players().size();
+}
+
+size_t Simulator::simulation_balls(size_t index) {
+	return active_sims().at(index).balls().size();
 }
 
 /**
@@ -346,42 +815,483 @@ const vec_obstacle_bodies& Simulator::fetch_obstacle_bodies() {
  */
 void Simulator::update_active_sim(double delta_t) {
 	active_sims()[current_sim_index()].update(delta_t);
+	keep_rewind_copy(active_sims()[current_sim_index()]);
+	publish_snapshot();
+}
+
+/**
+ * The steps run again are kept like the first time. They give the same simulation 
+ * (see Simulation::restore), so the copies after the target step are just taken again
+ * when the simulation goes forward.
+ */
+bool Simulator::step_back(size_t nb_steps) {
+	if(active_sims().empty() || sim_thread().joinable()) return false;
+	
+	Simulation& simulation(active_sims()[current_sim_index()]);
+	if(nb_steps > simulation.nb_steps()) return false;
+	size_t target(simulation.nb_steps() - nb_steps);
+	
+	const Rewind_Snapshot* snapshot(rewind_ring().find(target));
+	if(snapshot == nullptr || simulation.restore(*snapshot) == false) return false;
+	rewind_ring().drop_after(snapshot->nb_steps);
+	
+	while(simulation.nb_steps() < target && simulation.state() == GAME_READY) {
+		simulation.step(DELTA_T);
+		keep_rewind_copy(simulation);
+	}
+	simulation.update_graphics();
+	publish_snapshot();
+	return true;
+}
+
+Rewind_Ring& Simulator::rewind_ring() {
+	static Rewind_Ring rewind_ring_;
+	return rewind_ring_;
+}
+
+/**
+ * Called by the thread stepping the active simulation after each of its steps.
+ */
+void Simulator::keep_rewind_copy(const Simulation& simulation) {
+	size_t nb_steps(simulation.nb_steps());
+	if(nb_steps % rewind_interval != 0) return;
+	
+	const Rewind_Snapshot* last(rewind_ring().find(nb_steps));
+	if(last == nullptr || last->nb_steps < nb_steps)	//not if no step was run
+		simulation.save_rewind(rewind_ring().push());
+}
+
+/**
+ * Snapshots go from the thread stepping the active simulation (the simulation thread
+ * while it runs, the gui thread otherwise) to the gui thread drawing them.
+ */
+Triple_Buffer<Render_Snapshot>& Simulator::snapshot_buffer() {
+	static Triple_Buffer<Render_Snapshot> snapshot_buffer_;
+	return snapshot_buffer_;
+}
+
+void Simulator::publish_snapshot() {
+	Render_Snapshot& snapshot(snapshot_buffer().back());
+	if(active_sims().empty()) {
+		snapshot = Render_Snapshot();
+	} else {
+		active_sims()[current_sim_index()].fill_snapshot(snapshot);
+	}
+	snapshot_buffer().publish();
+}
+
+const Render_Snapshot& Simulator::fetch_snapshot() {
+	return snapshot_buffer().front();
+}
+
+std::thread& Simulator::sim_thread() {
+	static std::thread sim_thread_;
+	return sim_thread_;
+}
+
+std::atomic<bool>& Simulator::sim_thread_stop() {
+	static std::atomic<bool> sim_thread_stop_(false);
+	return sim_thread_stop_;
+}
+
+std::atomic<bool>& Simulator::fast_mode_flag() {
+	static std::atomic<bool> fast_mode_(false);
+	return fast_mode_;
+}
+
+void Simulator::fast_mode(bool fast) {
+	fast_mode_flag() = fast;
+}
+
+std::mutex& Simulator::capture_mutex() {
+	static std::mutex capture_mutex_;
+	return capture_mutex_;
+}
+
+std::vector<std::promise<Saved_State>>& Simulator::capture_requests() {
+	static std::vector<std::promise<Saved_State>> capture_requests_;
+	return capture_requests_;
+}
+
+bool& Simulator::sim_thread_serving() {
+	static bool sim_thread_serving_(false);
+	return sim_thread_serving_;
+}
+
+std::atomic<bool>& Simulator::capture_requested() {
+	static std::atomic<bool> capture_requested_(false);
+	return capture_requested_;
+}
+
+/**
+ * Gives one copy of the active simulation to each request. Must be called with 
+ * capture_mutex() locked, from the thread that steps the simulation.
+ */
+void Simulator::serve_captures() {
+	if(capture_requests().empty()) return;
+	
+	Saved_State state;
+	active_sims()[current_sim_index()].save_state(state);
+	for(auto& request : capture_requests())
+		request.set_value(state);
+	capture_requests().clear();
+	capture_requested() = false;
+}
+
+bool Simulator::start_sim_thread() {
+	if(sim_thread().joinable() || active_simulation_state() != GAME_READY)
+		return false;
+	
+	sim_thread_stop() = false;
+	{
+	std::lock_guard<std::mutex> lock(capture_mutex());
+	sim_thread_serving() = true;
+	}
+	sim_thread() = std::thread(run_sim_thread);
+	return true;
+}
+
+bool Simulator::stop_sim_thread() {
+	if(sim_thread().joinable() == false)
+		return false;
+	
+	sim_thread_stop() = true;
+	sim_thread().join();
+	return true;
+}
+
+/**
+ * Steps the active simulation at the pace of the gui timer it replaces (one step per
+ * DELTA_T). A step late by more than a period isn't caught up: the simulation slows
+ * down instead of running a burst of steps.
+ * 
+ * In fast mode, steps run back to back for a frame budget and only the state at the 
+ * end of the budget is published: the gui can't draw more often anyway, and copying 
+ * the bodies after every step would take a good part of the time of small steps.
+ * 
+ * Copies asked by save_in_background are taken along with the snapshots. The ones 
+ * still asked when the thread ends are taken before it stops serving them.
+ */
+void Simulator::run_sim_thread() {
+	typedef std::chrono::steady_clock Clock;
+	const Clock::duration step_period(std::chrono::duration_cast<Clock::duration>(
+										std::chrono::duration<double>(DELTA_T)));
+	const Clock::duration frame_budget(std::chrono::duration_cast<Clock::duration>(
+									std::chrono::duration<double>(fast_frame_budget)));
+	
+	Simulation& simulation(active_sims()[current_sim_index()]);
+	Clock::time_point next_step(Clock::now());
+	
+	while(simulation.state() == GAME_READY) {
+		if(fast_mode_flag()) {
+			Clock::time_point frame_end(Clock::now() + frame_budget);
+			do {
+				simulation.step(DELTA_T);
+				keep_rewind_copy(simulation);
+			} while(simulation.state() == GAME_READY && Clock::now() < frame_end
+					&& sim_thread_stop() == false);
+			simulation.update_graphics();
+			publish_snapshot();
+			if(capture_requested()) {
+				std::lock_guard<std::mutex> lock(capture_mutex());
+				serve_captures();
+			}
+			
+			next_step = Clock::now();	//back to normal speed from here
+			if(sim_thread_stop()) break;
+			continue;
+		}
+		
+		next_step = std::max(next_step + step_period, Clock::now());
+		std::this_thread::sleep_until(next_step);
+		if(sim_thread_stop()) break;
+		
+		simulation.update(DELTA_T);
+		keep_rewind_copy(simulation);
+		publish_snapshot();
+		if(capture_requested()) {
+			std::lock_guard<std::mutex> lock(capture_mutex());
+			serve_captures();
+		}
+	}
+	
+	std::lock_guard<std::mutex> lock(capture_mutex());
+	serve_captures();
+	sim_thread_serving() = false;
+}
+
+/**
+ * Updates all simulations by one step. Simulations share no data, each one is 
+ * updated by a single thread of the pool.
+ */
+void Simulator::update_all_sims(double delta_t) {
+	std::vector<Simulation>& sims(active_sims());
+	thread_pool().parallel_for(sims.size(), [&sims, delta_t](size_t i) {
+		sims[i].update(delta_t);
+	});
+}
+
+/**
+ * Runs all simulations without graphics for "nb_steps" steps or until they stop.
+ * Each simulation runs all its steps on one thread, there is no synchronisation 
+ * between steps.
+ */
+void Simulator::run_all_sims(size_t nb_steps) {
+	std::vector<Simulation>& sims(active_sims());
+	thread_pool().parallel_for(sims.size(), [&sims, nb_steps](size_t i) {
+		sims[i].advance(nb_steps);
+		sims[i].update_graphics();
+	});
+}
+
+/**
+ * Saves the current simulation to given path 
+ */
+void Simulator::save_simulation(const std::string &file_path) {
+	save_simulation(current_sim_index(), file_path);
+}
+
+bool Simulator::save_simulation(size_t index, const std::string &file_path) {
+	return active_sims().at(index).save(file_path);
+}
+
+/**
+ * The simulation thread must not run (see start_sim_thread).
+ */
+bool Simulator::start_recording(const std::string &file_path) {
+	if(active_sims().empty()) return false;
+	return active_sims()[current_sim_index()].start_recording(file_path);
+}
+
+bool Simulator::stop_recording() {
+	if(active_sims().empty()) return false;
+	return active_sims()[current_sim_index()].stop_recording();
+}
+
+/**
+ * Text format, or binary snapshot format for ".snap" paths (see snapshot.h).
+ */
+bool Simulator::write_state(Saved_State const& state, const std::string &file_path) {
+	return write_state_file(State_View(state), file_path);
+}
+
+/**
+ * Same bodies as Simulation::fill_snapshot, the obstacles are placed like in 
+ * Map::create_obstacle.
+ */
+void Simulator::fill_snapshot(Saved_State const& state, Render_Snapshot& snapshot) {
+	Simulation_Parameters parameters;
+	Length cell_side(SIDE / state.nb_cells);
+	snapshot.state = state.players.size() < 2 ? GAME_OVER : GAME_READY;
+	
+	snapshot.players.clear();
+	for(auto const& player : state.players) {
+		// lives out of 1..MAX_TOUCH only come from a damaged file
+		uint32_t lives(std::min<uint32_t>(std::max<uint32_t>(player.lives, 1), 
+										  MAX_TOUCH));
+		auto player_color = static_cast<Predefined_Color>(lives-1);
+		Angle arc_angle(2*M_PI*(player.cooldown/(double) parameters.max_count));
+		snapshot.players.emplace_back(Circle({player.x, player.y}, 
+											 parameters.coef_player_radius * cell_side),
+									  arc_angle, player_color);
+	}
+	
+	snapshot.balls.clear();
+	for(auto const& ball : state.balls) {
+		snapshot.balls.emplace_back(Coordinate(ball.x, ball.y), 
+									parameters.coef_ball_radius * cell_side);
+	}
+	
+	snapshot.obstacles.clear();
+	size_t nb_bits(state.nb_cells * state.nb_cells);
+	for(size_t bit(Tools::mask_next(state.obstacles.data(), nb_bits, 0)); bit < nb_bits;
+		bit = Tools::mask_next(state.obstacles.data(), nb_bits, bit + 1)) {
+		size_t line(bit / state.nb_cells), col(bit % state.nb_cells);
+		snapshot.obstacles.emplace_back(Coordinate(-DIM_MAX + col * cell_side, 
+												   DIM_MAX - (line+1) * cell_side),
+										cell_side, cell_side);
+	}
+}
+
+/**
+ * The state is copied right away if the simulation thread doesn't run, otherwise 
+ * the saving thread waits for the copy taken after the current step.
+ */
+bool Simulator::save_in_background(const std::string& file_path,
+								   std::function<void(bool)> on_saved) {
+	if(saving_flag() || active_sims().empty())
+		return false;
+	finish_save();
+	
+	std::promise<Saved_State> request;
+	std::future<Saved_State> state(request.get_future());
+	{
+	std::lock_guard<std::mutex> lock(capture_mutex());
+	if(sim_thread_serving()) {
+		capture_requests().push_back(std::move(request));
+		capture_requested() = true;
+	} else {
+		Saved_State copy;
+		active_sims()[current_sim_index()].save_state(copy);
+		request.set_value(std::move(copy));
+	}
+	}
+	
+	saving_flag() = true;
+	save_thread() = std::thread([file_path, on_saved](std::future<Saved_State> state) {
+		bool success(write_state(state.get(), file_path));
+		saving_flag() = false;
+		if(on_saved) on_saved(success);
+	}, std::move(state));
+	return true;
+}
+
+void Simulator::finish_save() {
+	if(save_thread().joinable())
+		save_thread().join();
+}
+
+std::thread& Simulator::save_thread() {
+	static std::thread save_thread_;
+	return save_thread_;
+}
+
+std::atomic<bool>& Simulator::saving_flag() {
+	static std::atomic<bool> saving_(false);
+	return saving_;
+}
+
+/**
+ * Runs every scenario with every parameter set, "nb_steps" steps at most, on the 
+ * thread pool. Each run loads its own simulation and destroys it when done, so that
+ * only one simulation per thread is in memory.
+ * 
+ * The result of scenario s with parameter set p is at index p*scenarios.size() + s.
+ */
+std::vector<Run_Result> Simulator::run_scenarios(
+							std::vector<std::string> const& scenarios,
+							std::vector<Simulation_Parameters> const& parameter_sets,
+							size_t nb_steps) {
+	
+	size_t nb_scenarios(scenarios.size());
+	std::vector<Run_Result> results(nb_scenarios * parameter_sets.size());
+	
+	thread_pool().parallel_for(results.size(), [&](size_t run) {
+		std::istringstream in_data(scenarios[run % nb_scenarios]);
+		Simulation simulation(in_data, parameter_sets[run / nb_scenarios]);
+		
+		Run_Result& result(results[run]);
+		result.loaded = simulation.success();
+		if(result.loaded == false) return;
+		
+		result.nb_steps = simulation.advance(nb_steps);
+		result.state = simulation.state();
+		result.nb_survivors = simulation.players().size();
+		result.nb_balls = simulation.balls().size();
+		result.nb_obstacles_destroyed = simulation.nb_obstacles_destroyed();
+	});
+	return results;
+}
+
+/**
+ * Prints the utilisation of each thread (nothing with a single thread).
+ */
+void Simulator::print_thread_statistics() {
+	if(thread_pool().nb_threads() > 1)
+		thread_pool().print_statistics(std::cout);
 }
 
 /**
- * Update all active sims. Multiple active simulations are not implemented yet.
+ * Steps the active simulation without graphics until "nb_steps" steps are done or the
+ * game stops, then saves it to "o_file_path". Prints the number of steps run, the 
+ * wall time and the resulting steps per second.
  */
-void Simulator::update_all_sims(double delta_t) {
-	for (auto& sim: active_sims()) {
-		sim.update(delta_t);
+bool Simulator::run_batch(const std::string &o_file_path, size_t nb_steps) {
+	if(active_sims().empty()) return false;
+	
+	Simulation& simulation(active_sims()[current_sim_index()]);
+	size_t nb_quiet_steps(simulation.nb_quiet_steps());
+	
+	auto start(std::chrono::steady_clock::now());
+	size_t nb_steps_run(simulation.advance(nb_steps));
+	std::chrono::duration<double> wall_time(std::chrono::steady_clock::now() - start);
+	nb_quiet_steps = simulation.nb_quiet_steps() - nb_quiet_steps;
+	
+	simulation.update_graphics();
+	
+	std::cout << nb_steps_run << " steps in " << wall_time.count() << " s";
+	if(wall_time.count() > 0)
+		std::cout << " (" << nb_steps_run / wall_time.count() << " steps/s)";
+	std::cout << std::endl;
+	if(nb_quiet_steps > 0)
+		std::cout << nb_quiet_steps << " quiet steps (players moving only)" << std::endl;
+	if(simulation.state() == GAME_OVER)
+		std::cout << "Game over after " << nb_steps_run << " steps" << std::endl;
+	else if(simulation.state() == PLAYER_TRAPPED)
+		std::cout << "Player trapped after " << nb_steps_run << " steps" << std::endl;
+	print_thread_statistics();
+	
+	return simulation.save(o_file_path);
+}
+
+bool Simulator::write_trajectory(const std::string &file_path, size_t nb_steps) {
+	std::ofstream o_file(file_path);
+	if(!o_file || active_sims().empty()) return false;
+	
+	Simulation& simulation(active_sims()[current_sim_index()]);
+	o_file << std::setprecision(std::numeric_limits<double>::max_digits10);
+	for(size_t step(0); step < nb_steps; ++step) {
+		simulation.update(DELTA_T);
+		simulation.write_positions(o_file);
 	}
+	return bool(o_file);
 }
 
-/**
- * Saves the current simulation to given path 
- */
-void Simulator::save_simulation(const std::string &file_path) {
-	active_sims()[current_sim_index()].save(file_path);
+bool Simulator::compare_trajectory(const std::string &file_path, size_t nb_steps) {
+	std::ifstream in_file(file_path);
+	if(!in_file || active_sims().empty()) return false;
+	
+	Simulation& simulation(active_sims()[current_sim_index()]);
+	Length max_error(0);
+	size_t max_error_step(0);
+	
+	for(size_t step(1); step <= nb_steps; ++step) {
+		simulation.update(DELTA_T);
+		
+		size_t nb_players(0), nb_balls(0);
+		if(!(in_file >> nb_players >> nb_balls)) {
+			std::cout << "Reference trajectory ends at step " << step << std::endl;
+			return false;
+		}
+		std::vector<Coordinate> positions(simulation.positions());
+		if(positions.size() != nb_players + nb_balls) {
+			std::cout << "Diverged at step " << step << ": " << positions.size() 
+					  << " entities instead of " << nb_players + nb_balls << std::endl;
+			return false;
+		}
+		
+		double x(0), y(0);
+		for(const auto& position : positions) {
+			in_file >> x >> y;
+			Length error(std::max(std::abs(position.x - x), std::abs(position.y - y)));
+			if(error > max_error) {
+				max_error = error;
+				max_error_step = step;
+			}
+		}
+	}
+	std::cout << "Validated " << nb_steps << " steps, maximum position error: " 
+			  << max_error << " (step " << max_error_step << ")" << std::endl;
+	return true;
 }
 
 /// ===== SIMULATION ===== ///
 
 // ===== Constructor ===== 
 
-Simulation::Simulation(std::vector<std::string>const& io_files) {
-		// set base types to debug values. They must be properly initialised during
-		// file import.															 
-		nb_cells_ = 0;
-		player_radius_ = -1.;
-		player_speed_ = -1;
-		ball_radius_ = -1.;
-		ball_speed_ = -1;
-		marge_jeu_ = -1.;
-		marge_lecture_ = -1.;
-		player_cooldown_per_t_ = 1;
-		max_dist_ = -1;
-		success_ = false;
-		state(GAME_READY);
+Simulation::Simulation(std::vector<std::string>const& io_files,
+					   Simulation_Parameters const& parameters) {
+	initialise_fields(parameters);
 		
 	if(Simulator::exec_parameters().at("Error")) {	//
 		if(io_files.empty())
@@ -401,6 +1311,8 @@ Simulation::Simulation(std::vector<std::string>const& io_files) {
 		}
 						
 		initialise_floyd_matrix();
+		if (success_)
+			reserve_ball_pool();
 
 		if (Simulator::exec_parameters().at("Step")){
 			update(DELTA_T);
@@ -414,6 +1326,45 @@ Simulation::Simulation(std::vector<std::string>const& io_files) {
 	}
 }
 
+Simulation::Simulation(std::istream& in_data, Simulation_Parameters const& parameters){
+	initialise_fields(parameters);
+	
+	Reader reader(BEGIN);
+	success_ = reader.import_stream(in_data, *this);
+	
+	initialise_floyd_matrix();
+	if (success_)
+		reserve_ball_pool();
+	
+	update_graphics();
+	if (players_.size() < 2) {
+		state(GAME_OVER);
+	}
+}
+
+/**
+ * Sets base types to debug values. They must be properly initialised during file 
+ * import.
+ */
+void Simulation::initialise_fields(Simulation_Parameters const& parameters) {
+	nb_cells_ = 0;
+	player_radius_ = -1.;
+	player_speed_ = -1;
+	ball_radius_ = -1.;
+	ball_speed_ = -1;
+	marge_jeu_ = -1.;
+	marge_lecture_ = -1.;
+	player_cooldown_per_t_ = 1;
+	max_dist_ = -1;
+	parameters_ = parameters;
+	success_ = false;
+	nb_steps_ = 0;
+	nb_quiet_steps_ = 0;
+	nb_obstacles_destroyed_ = 0;
+	tiles_active_ = false;
+	state(GAME_READY);
+}
+
 // ===== Public methods ===== 
 
 
@@ -443,14 +1394,14 @@ void Simulation::initialise_dimensions(size_t nb_cells) {
 
 	nb_cells_ = nb_cells;
 	
-	player_radius_ = COEF_RAYON_JOUEUR * (SIDE/nb_cells);
-	player_speed_ = COEF_VITESSE_JOUEUR * (SIDE/nb_cells);
+	player_radius_ = parameters_.coef_player_radius * (SIDE/nb_cells);
+	player_speed_ = parameters_.coef_player_speed * (SIDE/nb_cells);
 		
-	ball_radius_ = COEF_RAYON_BALLE * (SIDE/nb_cells);
-	ball_speed_ = COEF_VITESSE_BALLE * (SIDE/nb_cells);
+	ball_radius_ = parameters_.coef_ball_radius * (SIDE/nb_cells);
+	ball_speed_ = parameters_.coef_ball_speed * (SIDE/nb_cells);
 	
-	marge_jeu_= COEF_MARGE_JEU * (SIDE/nb_cells);
-	marge_lecture_= (COEF_MARGE_JEU/2) * (SIDE/nb_cells);
+	marge_jeu_= parameters_.coef_marge_jeu * (SIDE/nb_cells);
+	marge_lecture_= (parameters_.coef_marge_jeu/2) * (SIDE/nb_cells);
 	
 	Floyd_Dist nb_cells2 (nb_cells * nb_cells);
 
@@ -477,18 +1428,25 @@ void Simulation::initialise_floyd_matrix() {
 	update_floyd();
 }
 
+/**
+ * Row k doesn't change during step k (floyd_matrix_[k][k] is 0), so the other rows
+ * of step k are updated in parallel with the same result.
+ */
 void Simulation::update_floyd(){
 	size_t floyd_size(floyd_matrix_.size());
-	Floyd_Dist sum(0);
 	for(size_t k(0); k < floyd_size; ++k) {
-		for(size_t i(0); i < floyd_size; ++i) {
-			for(size_t j(0); j < floyd_size; ++j) { //symmetric matrix
-				sum = floyd_matrix_[k][i] + floyd_matrix_[k][j];  
-				if(sum < floyd_matrix_[j][i]){
-					floyd_matrix_[j][i] = sum;		
-				}	
-			}	
-		}		
+		const std::vector<Floyd_Dist>& row_k(floyd_matrix_[k]);
+		
+		Simulator::thread_pool().parallel_for(floyd_size, [&](size_t j) {
+			std::vector<Floyd_Dist>& row_j(floyd_matrix_[j]);
+			Floyd_Dist k_to_j(row_k[j]);	//symmetric matrix
+			for(size_t i(0); i < floyd_size; ++i) {
+				Floyd_Dist sum(row_k[i] + k_to_j);
+				if(sum < row_j[i]){
+					row_j[i] = sum;
+				}
+			}
+		}, floyd_rows_per_task);
 	}
 }
 
@@ -583,7 +1541,8 @@ Coordinate Simulation::player_floyd_target(const Player& player, bool& trapped)
 	size_t player_x(player_pos.first), player_y(player_pos.second);
 	size_t target_x(target_pos.first), target_y(target_pos.second);
 	
-	std::vector<Index_Pair> obs_around(obstacles_around(player_x, player_y));
+	Index_Pair obs_around[neighbor_number];	// (the frame arena isn't thread safe)
+	size_t nb_obs_around(obstacles_around(player_x, player_y, obs_around));
 			
 	size_t max_index(nb_cells_ - 1);
 	
@@ -606,8 +1565,8 @@ Coordinate Simulation::player_floyd_target(const Player& player, bool& trapped)
 			
 			bool will_collide(false);
 			if (distance < min_distance){
-				for (const auto& obs_pos : obs_around) {		
-					if (Tools::segment_not_connected(obstacles().at(obs_pos),
+				for (size_t k(0); k < nb_obs_around; ++k) {
+					if (Tools::segment_not_connected(obstacles().at(obs_around[k]),
 													 player.position(),
 													 get_cell_center(player_x + i, 
 																	 player_y + j), 
@@ -641,6 +1600,18 @@ Index_Pair Simulation::get_grid_position(Coordinate const& coord){
 		   ((size_t)((coord.x/SIDE + center_pos) * nb_cells_)));
 }
 
+/**
+ * Same as get_grid_position for any coordinate, also outside of the arena (e.g. balls
+ * leaving it): the coordinate is brought back on the closest cell.
+ */
+Index_Pair Simulation::get_clamped_grid_position(Coordinate const& coord) {
+	Coordinate clamped(std::min<double>(std::max<double>(coord.x, -DIM_MAX), DIM_MAX),
+					   std::min<double>(std::max<double>(coord.y, -DIM_MAX), DIM_MAX));
+	Index_Pair cell(get_grid_position(clamped));
+	return Index_Pair(std::min(cell.first, nb_cells_ - 1), 
+					  std::min(cell.second, nb_cells_ - 1));
+}
+
 Coordinate Simulation::get_cell_center(size_t x, size_t y) {
 	static constexpr double side_coeff(SIDE / DIM_MAX);
 	Length half_square(DIM_MAX / nb_cells_);
@@ -650,11 +1621,14 @@ Coordinate Simulation::get_cell_center(size_t x, size_t y) {
 
 /**
  * There are relatively few cases so an if cascade is sufficient.
+ * "obstacle_vec" must have room for neighbor_number pairs, the number of pairs
+ * written is returned.
  */
-std::vector<Index_Pair> Simulation::obstacles_around(size_t x, size_t y){
-	static constexpr size_t neighbor_number(8);
-	std::vector<Index_Pair> obstacle_vec;
-	obstacle_vec.reserve(neighbor_number);
+size_t Simulation::obstacles_around(size_t x, size_t y, Index_Pair* obstacle_vec){
+	size_t nb_obstacles(0);
+	auto push_back = [&](Index_Pair const& obs_pos) {
+		obstacle_vec[nb_obstacles++] = obs_pos;
+	};
 	
 	// bound check
 	bool left_side(y==0);
@@ -664,26 +1638,26 @@ std::vector<Index_Pair> Simulation::obstacles_around(size_t x, size_t y){
 	
 	if(left_side == false){
 		if(map_.is_obstacle(x,y-1)) 
-			obstacle_vec.push_back(Index_Pair(x, y-1));
+			push_back(Index_Pair(x, y-1));
 		if(on_top == false && map_.is_obstacle(x-1,y-1))
-			obstacle_vec.push_back(Index_Pair(x-1, y-1));
+			push_back(Index_Pair(x-1, y-1));
 		if(on_bottom == false && map_.is_obstacle(x+1,y-1))
-			obstacle_vec.push_back(Index_Pair(x+1, y-1));
+			push_back(Index_Pair(x+1, y-1));
 	}
 	if(right_side == false){
 		if(map_.is_obstacle(x,y+1)) 
-			obstacle_vec.push_back(Index_Pair(x,y+1));
+			push_back(Index_Pair(x,y+1));
 		if(on_top == false && map_.is_obstacle(x-1,y+1))
-			obstacle_vec.push_back(Index_Pair(x-1,y+1));
+			push_back(Index_Pair(x-1,y+1));
 		if(on_bottom == false && map_.is_obstacle(x+1,y+1))
-			obstacle_vec.push_back(Index_Pair(x+1,y+1));
+			push_back(Index_Pair(x+1,y+1));
 	}
 	if(on_bottom == false && map_.is_obstacle(x+1, y))
-		obstacle_vec.push_back(Index_Pair(x+1,y));
+		push_back(Index_Pair(x+1,y));
 	if(on_top == false && map_.is_obstacle(x-1, y))
-		obstacle_vec.push_back(Index_Pair(x-1,y));
+		push_back(Index_Pair(x-1,y));
 
-	return obstacle_vec;
+	return nb_obstacles;
 }   
 
 
@@ -691,137 +1665,517 @@ void Simulation::update(double delta_t) {
 		
 	if(state() != GAME_READY) return;
 	
+	step(delta_t);
+	update_graphics();
+}
 
+void Simulation::step(double delta_t) {
+	
+	if(state() != GAME_READY) return;
+	
+	frame_arena_.reset();	// temporaries of the previous step are released
+	++nb_steps_;
 	
 	update_player_targets();
 	update_player_directions();
+	finish_step();
+	record_step();
+}
+
+/**
+ * Phases of a step after the directions.
+ */
+void Simulation::finish_step() {
 	update_player_positions();
 	perform_player_actions();
 	update_ball_positions();
 	handle_ball_collisions();
-	remove_collided_balls();
-	remove_dead_players();
-	update_graphics();
+	apply_commands();
 	
 	if (players_.size() < 2) {
 		state(GAME_OVER);
 	}
 }
 
+/**
+ * Steps without balls in flight go through quiet_step as long as the horizon allows.
+ */
+size_t Simulation::advance(size_t nb_steps) {
+	size_t nb_steps_run(0);
+	
+	while(nb_steps_run < nb_steps && state() == GAME_READY) {
+		size_t horizon(quiet_horizon(nb_steps - nb_steps_run));
+		
+		if(horizon == 0) {
+			step(DELTA_T);
+			++nb_steps_run;
+		}
+		for(size_t i(0); i < horizon; ++i) {
+			++nb_steps_run;
+			if(quiet_step() == false || state() != GAME_READY) break;
+		}
+	}
+	return nb_steps_run;
+}
+
+/**
+ * Number of coming steps (at most "max_steps") that can be run by quiet_step: no ball
+ * is in flight, every player keeps its target (its nearest player) and no player 
+ * comes close enough to another one to be blocked. These are the bounds given by the
+ * last target search of each player (see update_player_targets), so the horizon 
+ * only takes their minimum. There is none before the first step and after players 
+ * are removed, until a step searches the targets again.
+ * 
+ * Throws, lines of sight and paths aren't bounded, quiet_step handles them.
+ */
+size_t Simulation::quiet_horizon(size_t max_steps) const {
+	size_t nb_players(players_.size());
+	if(balls_.empty() == false || nb_players < 2 || 
+	   target_kept_until_.size() != nb_players) 
+		return 0;
+	
+	size_t quiet_until(std::numeric_limits<size_t>::max());
+	for(size_t i(0); i < nb_players; ++i)
+		quiet_until = std::min({quiet_until, target_kept_until_[i], free_until_[i]});
+	
+	if(quiet_until <= nb_steps_) return 0;
+	return std::min(max_steps, quiet_until - nb_steps_);
+}
+
+/**
+ * One step knowing that the targets don't change and that no player can be blocked 
+ * (see quiet_horizon): targets, player collisions and ball phases are skipped. 
+ * Directions are computed like in step(). If a player throws, the step is finished 
+ * like a normal one and false is returned: the horizon ends there.
+ */
+bool Simulation::quiet_step() {
+	frame_arena_.reset();
+	++nb_steps_;
+	
+	update_player_directions();
+	
+	for(auto const& player : players_) {
+		if(player.target_seen() && 
+		   player.cooldown() + player_cooldown_per_t_ >= parameters_.max_count) {
+			finish_step();
+			record_step();
+			return false;
+		}
+	}
+	
+	Length dist_per_t(DELTA_T * player_speed_);
+	for(auto& player : players_) {
+		player.move(player.direction() * dist_per_t);
+		player.cool_down(player_cooldown_per_t_);
+	}
+	++nb_quiet_steps_;
+	record_step();
+	return true;
+}
+
+/**
+ * The simulation only copies its state, the recorder encodes and writes it on its 
+ * own thread.
+ */
+void Simulation::record_step() {
+	if(recorder_ == nullptr) return;
+	
+	save_state(recorder_->next_frame());
+	recorder_->commit(nb_steps_);
+}
+
+bool Simulation::start_recording(const std::string &o_file_path) {
+	recorder_.reset(new Trajectory_Recorder(o_file_path, nb_cells_));
+	if(recorder_->is_open() == false) {
+		recorder_.reset();
+		return false;
+	}
+	record_step();
+	return true;
+}
+
+bool Simulation::stop_recording() {
+	if(recorder_ == nullptr) return false;
+	
+	bool success(recorder_->close());
+	recorder_.reset();
+	return success;
+}
+
 void Simulation::update_graphics() {
 	update_player_graphics();
 	update_ball_bodies();
 	update_obstacle_bodies();
 }
 
+/**
+ * Whole steps before a gap of "distance" closing by "per_step" each step is used up.
+ */
+static size_t steps_within(Length distance, Length per_step) {
+	if(distance <= 0) return 0;
+	if(per_step <= 0) return std::numeric_limits<size_t>::max() / 2;
+	return std::min<double>(std::floor(distance / per_step), 
+							std::numeric_limits<size_t>::max() / 2);
+}
+
+/**
+ * Each player only writes its own target, the positions are only read.
+ * 
+ * The search also gives how long its result holds. A player moves at most dist_per_t
+ * per step, so distances between players change by at most 2*dist_per_t per step: 
+ * the target stays the nearest player while the gap to the second nearest one is 
+ * larger than 4*dist_per_t per step, and the player can't be blocked while its 
+ * nearest player is further than the contact distance (see move_players_in_order) 
+ * plus 2*dist_per_t per step. Players far from the others thus search their target
+ * and test their collisions only once in a while, crowded ones at every step.
+ * The bounds are reset when players are removed (the indexes change).
+ */
 void Simulation::update_player_targets() {
 	
 	size_t players_size(players_.size());
-	for(size_t i(0); i < players_size; ++i) {
-		
-		Length min_distance2(DIM_MAX*DIM_MAX*DIM_MAX*(double)DIM_MAX);
-
-		for(size_t j(0); j < players_size; ++j) {
-			if (i == j) continue;
-			Length distance2(Tools::dist_squared(players_[i].body().center(),
-												 players_[j].body().center()));
-			if (distance2 < min_distance2) {
-				min_distance2 = distance2;
-				players_[i].target(&(players_[j]));
+	if(target_kept_until_.size() != players_size) {
+		target_kept_until_.assign(players_size, 0);
+		free_until_.assign(players_size, 0);
+	}
+	
+	Length dist_per_t(DELTA_T * player_speed_);
+	Length slack(horizon_slack * SIDE);
+	Length contact(2 * player_radius_ + marge_jeu_ + dist_per_t);
+	
+	for_each_player_chunk(nb_player_chunks(), [&](size_t, size_t begin, size_t end) {
+		for(size_t i(begin); i < end; ++i) {
+			if(nb_steps_ <= target_kept_until_[i]) continue;
+			
+			Length min_distance2(DIM_MAX*DIM_MAX*DIM_MAX*(double)DIM_MAX);
+			Length second_distance2(min_distance2);
+	
+			for(size_t j(0); j < players_size; ++j) {
+				if (i == j) continue;
+				Length distance2(Tools::dist_squared(players_[i].body().center(),
+													 players_[j].body().center()));
+				if (distance2 < min_distance2) {
+					second_distance2 = min_distance2;
+					min_distance2 = distance2;
+					players_[i].target(&(players_[j]));
+				} else if (distance2 < second_distance2) {
+					second_distance2 = distance2;
+				}
 			}
+			
+			Length nearest(std::sqrt(min_distance2));
+			target_kept_until_[i] = nb_steps_ + steps_within(
+						std::sqrt(second_distance2) - nearest - slack, 4 * dist_per_t);
+			// the others may have moved once more when the player moves
+			free_until_[i] = nb_steps_ + steps_within(
+						nearest - contact - slack - dist_per_t, 2 * dist_per_t) - 1;
 		}
-	}
+	});
 }
 
+/**
+ * Each player only writes its own direction. The trapped state is set once all 
+ * players are done.
+ */
 void Simulation::update_player_directions() {
 	
-	if (players_.size() < 2) return;
+	size_t nb_players(players_.size());
+	if (nb_players < 2) return;
+	
+	Rectangle_Span obstacle_span(map_.obstacle_arrays().span());
+	Length tolerance_w_radius(player_radius_ + marge_jeu_);
+	
+	size_t nb_chunks(nb_player_chunks());
+	Mask_Word* masks(frame_arena_.allocate<Mask_Word>(nb_chunks * 
+										(Tools::mask_words(obstacle_span.size) + 1)));
+	bool* trapped_chunks(frame_arena_.allocate<bool>(nb_chunks));
 	
-	for (auto& player : players_) {
+	for_each_player_chunk(nb_chunks, [&](size_t chunk, size_t begin, size_t end) {
+		Mask_Word* mask(masks + chunk * (Tools::mask_words(obstacle_span.size) + 1));
+		trapped_chunks[chunk] = false;
 		
-		bool intersects(false);
-		for(const auto& obs : obstacles()) {
-			Length tolerance_w_radius(player_radius_ + marge_jeu_);
-			if (Tools::segment_not_connected(obs.second, player.body().center(), 
+		for (size_t i(begin); i < end; ++i) {
+			Player& player(players_[i]);
+			
+			// line of sight against all obstacles at once
+			Tools::segment_not_connected(obstacle_span, player.body().center(), 
 										 player.target()->body().center(),
-										 tolerance_w_radius)) {
-				intersects = true;
-				break;							 
-			}
-		}
-		player.target_seen(!intersects);
-		
-		if (player.target_seen()) {
-			Vector to_target(player.target()->body().center()-player.body().center());
-			player.direction(Vector(to_target));
-		}
-		else {
-			bool trapped(false);
-			Vector to_target (player_floyd_target(player, trapped) - 
-							  player.body().center());
-			if (to_target.length() <= marge_jeu_) 
-				player.direction(Vector(0,0));
-			else 
+										 tolerance_w_radius, mask);
+			player.target_seen(!Tools::mask_any(mask, obstacle_span.size));
+			
+			if (player.target_seen()) {
+				Vector to_target(player.target()->body().center() -
+								 player.body().center());
 				player.direction(Vector(to_target));
-			if (trapped) state(PLAYER_TRAPPED);
+			}
+			else {
+				bool trapped(false);
+				Vector to_target (player_floyd_target(player, trapped) - 
+								  player.body().center());
+				if (to_target.length() <= marge_jeu_) 
+					player.direction(Vector(0,0));
+				else 
+					player.direction(Vector(to_target));
+				if (trapped) trapped_chunks[chunk] = true;
+			}
 		}
-	}
+	});
+	
+	if (std::any_of(trapped_chunks, trapped_chunks + nb_chunks, [](bool trapped) {
+		return trapped;
+	})) state(PLAYER_TRAPPED);
 }
 
 /**
+ * Players move in index order: a player doesn't move if it would collide with any 
+ * other player, at its new position for players already moved in this step.
+ * 
  * Player directions must be udated before using this function.
  */ 
 void Simulation::update_player_positions() {
 	size_t nb_players(players_.size());
-	Vector to_move;
 	Length dist_per_t(DELTA_T * player_speed_);
-	bool can_move(true);
 	
+	Vector* moves(frame_arena_.allocate<Vector>(nb_players));
+	player_circles_.clear();
 	for(size_t i(0); i < nb_players; ++i) {
-		to_move = players_[i].direction();
-		if (to_move.length() != 0.) to_move.length(dist_per_t);
-				
-		for(size_t j(0); j < nb_players; ++j) {
-			if (i == j) continue;
-			// No movement if it leads to collision
-			if (Tools::intersect(players_[i].body(), players_[j].body(), 
-								 marge_jeu_ + dist_per_t))
-				can_move = false;
+		player_circles_.push_back(players_[i].body());
+		moves[i] = players_[i].direction() * dist_per_t;	// direction is unit or zero
+	}
+	if(parameters_.swept_balls) {
+		player_starts_.clear();
+		for(const auto& player : players_)
+			player_starts_.push_back(player.position());
+	}
+	
+	tiles_active_ = nb_players >= min_players_for_tiles || nb_player_chunks() > 1;
+	if(tiles_active_)
+		move_players_in_tiles(moves);
+	else
+		move_players_in_order(moves);
+}
+
+void Simulation::move_players_in_order(Vector const* moves) {
+	size_t nb_players(players_.size());
+	Mask_Word* mask(scratch_mask(nb_players));
+	Length contact2(Tools::contact_squared(player_radius_, player_radius_, 
+										   marge_jeu_ + DELTA_T * player_speed_));
+	
+	for(size_t i(0); i < nb_players; ++i) {
+		
+		if(nb_steps_ <= free_until_[i]) {	// far from the others (see targets)
+			players_[i].move(moves[i]);
+			player_circles_.center(i, players_[i].position());
+			continue;
+		}
+		
+		// No movement if it leads to collision with any other player
+		Tools::overlap(players_[i].position(), player_circles_.span(), contact2, mask);
+		Tools::mask_reset(mask, i);
+		
+		if (Tools::mask_any(mask, nb_players) == false) {
+			players_[i].move(moves[i]);
+			player_circles_.center(i, players_[i].position());
+		}
+	}
+}
+
+/**
+ * Same result as move_players_in_order, in two phases:
+ * 
+ * - read (one task per tile, in parallel): each player i is tested against the 
+ *   players seen by its tile, at their position before any move (before_move) and 
+ *   after their move (after_move). A hit with a player j > i blocks i for sure (j 
+ *   hasn't moved yet when i moves); hits with players j < i are kept as candidates.
+ * - commit (in order): i moves if no candidate blocks it, knowing which players 
+ *   before i have moved.
+ * 
+ * The halo of the tiles covers the contact distance plus the move of a player, so a
+ * tile sees all the players that can block the players it owns.
+ */
+void Simulation::move_players_in_tiles(Vector const* moves) {
+	size_t nb_players(players_.size());
+	Length contact2(Tools::contact_squared(player_radius_, player_radius_, 
+										   marge_jeu_ + DELTA_T * player_speed_));
+	update_player_tiles();
+	
+	Coordinate* moved_positions(frame_arena_.allocate<Coordinate>(nb_players));
+	for(size_t i(0); i < nb_players; ++i) {
+		Player moved_player(players_[i]);
+		moved_player.move(moves[i]);
+		moved_positions[i] = moved_player.position();
+	}
+	
+	bool* blocked(frame_arena_.allocate<bool>(nb_players));
+	size_t* first_candidate(frame_arena_.allocate<size_t>(nb_players));
+	size_t* nb_candidates(frame_arena_.allocate<size_t>(nb_players));
+	
+	size_t nb_tiles(player_tiles_.nb_tiles());
+	if(tile_scratch_.size() < nb_tiles)
+		tile_scratch_.resize(nb_tiles);
+	
+	// read phase
+	Simulator::thread_pool().parallel_for(nb_tiles, [&](size_t t) {
+		const Tile_Grid::Tile& tile(player_tiles_.tile(t));
+		Tile_Scratch& scratch(tile_scratch_[t]);
+		
+		scratch.players.assign(tile.owned.begin(), tile.owned.end());
+		scratch.players.insert(scratch.players.end(), tile.ghosts.begin(), 
+							   tile.ghosts.end());
+		scratch.before_move.clear();
+		scratch.after_move.clear();
+		for(size_t k(0); k < scratch.players.size(); ++k) {
+			scratch.before_move.push_back(players_[scratch.players[k]].body());
+			scratch.after_move.push_back(players_[scratch.players[k]].body());
+			scratch.after_move.center(k, moved_positions[scratch.players[k]]);
+		}
+		scratch.candidates.clear();
+		
+		size_t nb_seen(scratch.players.size());
+		size_t mask_size(Tools::mask_words(nb_seen) + 1);
+		scratch.masks.resize(2 * mask_size);
+		Mask_Word* before_move(scratch.masks.data());
+		Mask_Word* after_move(before_move + mask_size);
+		
+		for(size_t k(0); k < tile.owned.size(); ++k) {
+			size_t i(scratch.players[k]);
+			first_candidate[i] = scratch.candidates.size();
+			nb_candidates[i] = 0;
+			
+			blocked[i] = false;
+			if(nb_steps_ <= free_until_[i]) continue;	// far from the others
+			
+			Tools::overlap(players_[i].position(), scratch.before_move.span(), 
+						   contact2, before_move);
+			Tools::mask_reset(before_move, k);
+			
+			for(size_t m(Tools::mask_next(before_move, nb_seen, 0)); m < nb_seen; 
+				m = Tools::mask_next(before_move, nb_seen, m + 1)) {
+				if(scratch.players[m] > i) {
+					blocked[i] = true;
+					break;
+				}
+			}
+			if(blocked[i]) continue;
+			
+			Tools::overlap(players_[i].position(), scratch.after_move.span(), 
+						   contact2, after_move);
+			for(size_t m(0); m < nb_seen; ++m) {
+				if(scratch.players[m] >= i) continue;
+				bool if_still(Tools::mask_test(before_move, m));
+				bool if_moved(Tools::mask_test(after_move, m));
+				if(if_still || if_moved) {
+					scratch.candidates.push_back({scratch.players[m], if_still, 
+												  if_moved});
+					++nb_candidates[i];
+				}
+			}
+		}
+	});
+	
+	// commit phase
+	bool* moved(frame_arena_.allocate<bool>(nb_players));
+	for(size_t i(0); i < nb_players; ++i) {
+		bool blocked_now(blocked[i]);
+		if(blocked_now == false) {
+			const Move_Candidate* candidates(
+						tile_scratch_[player_tiles_.tile_of(i)].candidates.data() + 
+						first_candidate[i]);
+			for(size_t k(0); k < nb_candidates[i]; ++k) {
+				blocked_now |= moved[candidates[k].player_index] ? 
+							   candidates[k].blocks_if_moved : 
+							   candidates[k].blocks_if_still;
+			}
 		}
-		if (can_move)		
-			players_[i].move(to_move);
-		can_move = true;
+		moved[i] = !blocked_now;
+		if(moved[i])
+			players_[i].move(moves[i]);
 	}
 }
 
+/**
+ * Places the players in the tiles at their current cell. The halo is the longest 
+ * interaction of a player (with a player or a ball) plus its move in a step, with a 
+ * small margin for rounding in get_grid_position.
+ */
+void Simulation::update_player_tiles() {
+	Length dist_per_t(DELTA_T * player_speed_);
+	Length ball_reach(player_radius_ + ball_radius_ + marge_jeu_);
+	if(parameters_.swept_balls)
+		ball_reach += ball_speed_ * DELTA_T;	//anywhere on the move of the ball
+	Length reach(std::max(2 * player_radius_ + marge_jeu_ + dist_per_t, ball_reach) + 
+				 dist_per_t);
+	size_t halo_cells(static_cast<size_t>(reach / (SIDE / nb_cells_) * (1 + 1e-9)) + 1);
+	player_tiles_.configure(nb_cells_, cells_per_tile, halo_cells);
+	
+	size_t nb_players(players_.size());
+	Index_Pair* cells(frame_arena_.allocate<Index_Pair>(nb_players));
+	for(size_t i(0); i < nb_players; ++i)
+		new (cells + i) Index_Pair(get_clamped_grid_position(players_[i].position()));
+	player_tiles_.update(cells, nb_players);
+}
+
 void Simulation::update_ball_positions() {
 	Length ball_dist_per_t(ball_speed_*DELTA_T);
 	for(auto& ball : balls_) {
-		Vector to_move(ball.direction());
-		to_move.length(ball_dist_per_t);
-		ball.move(to_move);
+		ball.move(ball.direction() * ball_dist_per_t);	// direction is a unit vector
 	}
 }
 
+/**
+ * Each player only writes its own cooldown, throws are recorded in the spawn buffer 
+ * of its chunk.
+ */
 void Simulation::perform_player_actions() {
 	
-	Coordinate ball_pos;
+	size_t nb_chunks(nb_player_chunks());
+	commands_.open_spawn_buffers(nb_chunks);
 	
-	for (auto& player : players_) {
-		player.cool_down(player_cooldown_per_t_);
-		
-		if (player.target_seen() == false) continue;
+	for_each_player_chunk(nb_chunks, [&](size_t chunk, size_t begin, size_t end) {
+		std::vector<Ball_Spawn>& spawns(commands_.spawn_buffer(chunk));
 		
-		if((player.cooldown() >= MAX_COUNT)) {
-			// ball is initialised 2*m_j away from player to prevent collision
-			ball_pos = player.position() + 
-					   (player.direction().get_unit()*(player_radius_ + ball_radius_ + 
-						marge_jeu_ * 2)).pointed();
-					   
-			initialise_ball(ball_pos.x, ball_pos.y, player.direction().angle());
-			player.cooldown(0);						
-		}	
+		for (size_t i(begin); i < end; ++i) {
+			Player& player(players_[i]);
+			player.cool_down(player_cooldown_per_t_);
+			
+			if (player.target_seen() == false) continue;
+			
+			if((player.cooldown() >= parameters_.max_count)) {
+				// ball is initialised 2*m_j away from player to prevent collision
+				Coordinate ball_pos(player.position() + 
+									(player.direction()*(player_radius_ + ball_radius_ 
+									 + marge_jeu_ * 2)).pointed());
+				
+				// the ball is created at the end of the step (see apply_commands)
+				spawns.push_back({ball_pos, player.direction()});
+				player.cooldown(0);						
+			}	
+		}
+	});
+	
+	commands_.merge_spawn_buffers();
+}
+
+/**
+ * Copies the bodies into "snapshot", reusing the capacity of its vectors.
+ */
+void Simulation::fill_snapshot(Render_Snapshot& snapshot) const {
+	snapshot.state = state_;
+	snapshot.nb_steps = nb_steps_;
+	
+	snapshot.players.clear();
+	for(auto const& player : players_) {
+		auto player_color = static_cast<Predefined_Color>(player.lives()-1);
+		Angle arc_angle(2*M_PI*(player.cooldown()/(double) parameters_.max_count));
+		snapshot.players.emplace_back(player.body(), arc_angle, player_color);
 	}
+	
+	snapshot.balls.clear();
+	for(auto const& ball : balls_)
+		snapshot.balls.push_back(ball.geometry());
+	
+	snapshot.obstacles.clear();
+	for(auto const& obs : obstacles())
+		snapshot.obstacles.push_back(obs.second);
 }
 
 void Simulation::update_player_graphics() {
@@ -840,7 +2194,7 @@ void Simulation::update_player_graphics() {
 		auto player_color = static_cast<Predefined_Color>(players_[i].lives()-1);
 		
 		// alpha = 2*pi * (cooldown / max cooldown) 
-		arc_angle = 2*M_PI*(players_[i].cooldown()/(double) MAX_COUNT);
+		arc_angle = 2*M_PI*(players_[i].cooldown()/(double) parameters_.max_count);
 
 		// modify existing values
 		player_graphics_[i] = std::make_tuple(&players_[i].body(), arc_angle, 
@@ -876,55 +2230,301 @@ void Simulation::handle_ball_collisions() {
 	size_t nb_balls(balls_.size());
 	if (nb_balls == 0) return;
 	
+	ball_circles_.clear();
+	for(const auto& ball : balls_)
+		ball_circles_.push_back(ball.geometry());
+	player_circles_.clear();
+	for(const auto& player : players_)
+		player_circles_.push_back(player.body());
+	
+	Mask_Word* ball_mask(scratch_mask(nb_balls));
+	Mask_Word* player_mask(scratch_mask(players_.size()));
+	Mask_Word* obstacle_mask(scratch_mask(map_.nb_obstacles()));
+	
+	// each iteration only writes the state of ball i, changes to players and 
+	// obstacles are recorded in commands_
 	for(size_t i(0); i < nb_balls; ++i) {
 		
-		if(test_center_position(balls_[i].geometry().center().x, 
-								balls_[i].geometry().center().y) == false) {
-			balls_[i].collided(true);	//collided with game frame
-		}
+		// out of the game frame
+		bool collided(test_center_position(balls_[i].geometry().center().x, 
+										   balls_[i].geometry().center().y) == false);
 		
-		for(size_t j(i + 1); j < nb_balls; ++j) {
-			if (detect_ball_ball_collision(balls_[i], balls_[j])) {
-				balls_[i].collided(true);
-				balls_[j].collided(true);
-			}
+		if(parameters_.swept_balls) {
+			collided |= record_swept_ball_hits(i, swept_ball_ball_impact(i, ball_mask),
+											   player_mask, obstacle_mask);
+		} else {
+			collided |= detect_ball_ball_collisions(i, ball_mask);
+			collided |= record_ball_player_hits(i, player_mask);
+			collided |= record_ball_obstacle_hits(i, obstacle_mask);
 		}
 		
-		handle_ball_player_collisions(balls_[i]);
-			
-		for(auto &obs : obstacles()) {
-			if(Tools::intersect(obs.second, balls_[i].geometry(), marge_jeu_)){
-				remove_obstacle(obs.first.first, obs.first.second);
-				balls_[i].collided(true);
+		if(collided) balls_[i].collided(true);
+	}
+}
+
+/**
+ * Tests the ball at "ball_index" against all other balls.
+ */
+bool Simulation::detect_ball_ball_collisions(size_t ball_index, Mask_Word* mask) const {
+	Circle_Span all_balls(ball_circles_.span());
+	Tools::overlap(balls_[ball_index].position(), all_balls, 
+				   Tools::contact_squared(ball_radius_, ball_radius_, marge_jeu_), mask);
+	Tools::mask_reset(mask, ball_index);
+	
+	return Tools::mask_any(mask, all_balls.size);
+}
+
+/**
+ * In big games only the players seen by the tile of the ball are tested.
+ */
+bool Simulation::record_ball_player_hits(size_t ball_index, Mask_Word* mask) {
+	
+	if(tiles_active_) {
+		Length contact2(Tools::contact_squared(ball_radius_, player_radius_, marge_jeu_));
+		const Tile_Grid::Tile& tile(player_tiles_.tile(player_tiles_.tile_at(
+							get_clamped_grid_position(balls_[ball_index].position()))));
+		bool collided(false);
+		for(const auto* players : {&tile.owned, &tile.ghosts}) {
+			for(size_t j : *players) {
+				if(Tools::overlap(balls_[ball_index].position(), players_[j].position(),
+								  contact2)) {
+					commands_.hit(j);
+					collided = true;
+				}
 			}
 		}
+		return collided;
 	}
+	
+	size_t nb_players(players_.size());
+	Tools::overlap(balls_[ball_index].position(), player_circles_.span(), 
+				   Tools::contact_squared(ball_radius_, player_radius_, marge_jeu_), 
+				   mask);
+	
+	bool collided(false);
+	for(size_t j(Tools::mask_next(mask, nb_players, 0)); j < nb_players; 
+		j = Tools::mask_next(mask, nb_players, j + 1)) {
+		commands_.hit(j);
+		collided = true;
+	}
+	return collided;
 }
 
-void Simulation::handle_ball_player_collisions(Ball& ball) {
+bool Simulation::record_ball_obstacle_hits(size_t ball_index, Mask_Word* mask) {
 	
-	bool player_collided(false);
-	size_t nb_players(players_.size());
+	Rectangle_Span obstacle_span(map_.obstacle_arrays().span());
+	Tools::intersect(obstacle_span, balls_[ball_index].geometry(), marge_jeu_, mask);
 	
-	for(size_t j(0); j < nb_players; ++j) {
-		player_collided = detect_ball_player_collision(ball, players_[j]);
-		if(player_collided) {
-			take_player_life(j);
-			ball.collided(true);
-		}
+	bool collided(false);
+	for(size_t k(Tools::mask_next(mask, obstacle_span.size, 0)); 
+		k < obstacle_span.size; k = Tools::mask_next(mask, obstacle_span.size, k+1)){
+		commands_.remove_obstacle(map_.obstacle_key(k));
+		collided = true;
+	}
+	return collided;
+}
+
+/**
+ * Continuous collisions (Simulation_Parameters::swept_balls): the tests above only 
+ * look at the positions at the end of the step, so a ball moving more than a contact 
+ * distance per step could go through a player or an obstacle. The tests below follow 
+ * the whole move of the step, with the time of impact as a fraction of the step.
+ * 
+ * Two balls collide if they come in contact at some point of the step. Returns the
+ * time of the first contact with another ball (above 1 if there is none). Like for 
+ * the players, candidates are selected with the end positions of the other balls 
+ * and a contact distance enlarged by their move.
+ */
+double Simulation::swept_ball_ball_impact(size_t ball_index, Mask_Word* mask) const {
+	Length ball_dist_per_t(ball_speed_*DELTA_T);
+	Length contact(2 * ball_radius_ + marge_jeu_);
+	Vector move(balls_[ball_index].direction() * ball_dist_per_t);
+	Coordinate start(balls_[ball_index].position() - move.pointed());
+	
+	size_t nb_balls(balls_.size());
+	Tools::swept_overlap(start, move, ball_circles_.span(), 
+						 Tools::square(contact + ball_dist_per_t), mask);
+	Tools::mask_reset(mask, ball_index);
+	
+	double first_impact(2.);
+	for(size_t j(Tools::mask_next(mask, nb_balls, 0)); j < nb_balls; 
+		j = Tools::mask_next(mask, nb_balls, j + 1)) {
+		Vector other_move(balls_[j].direction() * ball_dist_per_t);
+		Coordinate other_start(balls_[j].position() - other_move.pointed());
+		
+		// in the frame of the other ball
+		first_impact = std::min(first_impact, 
+								Tools::time_of_impact(start - other_start, 
+													  move - other_move, {0, 0}, 
+													  contact * contact));
+	}
+	return first_impact;
+}
+
+/**
+ * The ball stops at its first impact, "ball_impact" being the one with the other 
+ * balls: only the players and obstacles it reaches first (at the same time, up to 
+ * rounding) are hit. Players move from their start to their end position during the 
+ * step, the test uses the move of the ball relative to the player. Candidates are 
+ * selected with the end positions of the players and a contact distance enlarged by
+ * their move.
+ */
+bool Simulation::record_swept_ball_hits(size_t ball_index, double ball_impact, 
+										Mask_Word* player_mask, 
+										Mask_Word* obstacle_mask) {
+	Length ball_dist_per_t(ball_speed_*DELTA_T);
+	Length player_dist_per_t(player_speed_*DELTA_T);
+	Length contact(player_radius_ + ball_radius_ + marge_jeu_);
+	Vector move(balls_[ball_index].direction() * ball_dist_per_t);
+	Coordinate start(balls_[ball_index].position() - move.pointed());
+	
+	auto player_impact = [&](size_t j) {
+		Vector player_move(player_starts_[j], players_[j].position());
+		return Tools::time_of_impact(start - player_starts_[j], move - player_move,
+									 {0, 0}, contact * contact);
+	};
+	
+	// candidates
+	std::vector<size_t>& candidates(hit_candidates_);
+	candidates.clear();
+	if(tiles_active_) {
+		const Tile_Grid::Tile& tile(player_tiles_.tile(player_tiles_.tile_at(
+							get_clamped_grid_position(balls_[ball_index].position()))));
+		candidates.insert(candidates.end(), tile.owned.begin(), tile.owned.end());
+		candidates.insert(candidates.end(), tile.ghosts.begin(), tile.ghosts.end());
+	} else {
+		size_t nb_players(players_.size());
+		Tools::swept_overlap(start, move, player_circles_.span(), 
+							 Tools::square(contact + player_dist_per_t), player_mask);
+		for(size_t j(Tools::mask_next(player_mask, nb_players, 0)); j < nb_players; 
+			j = Tools::mask_next(player_mask, nb_players, j + 1))
+			candidates.push_back(j);
+	}
+	Rectangle_Span obstacle_span(map_.obstacle_arrays().span());
+	Length obstacle_tolerance(ball_radius_ + marge_jeu_);
+	Tools::swept_intersect(obstacle_span, start, move, obstacle_tolerance, 
+						   obstacle_mask);
+	
+	auto obstacle_impact = [&](size_t k) {
+		return Tools::time_of_impact(start, move, 
+									 obstacles().at(map_.obstacle_key(k)), 
+									 obstacle_tolerance);
+	};
+	
+	// first impact
+	double first_impact(ball_impact);
+	for(size_t j : candidates)
+		first_impact = std::min(first_impact, player_impact(j));
+	size_t nb_obstacles(obstacle_span.size);
+	for(size_t k(Tools::mask_next(obstacle_mask, nb_obstacles, 0)); k < nb_obstacles; 
+		k = Tools::mask_next(obstacle_mask, nb_obstacles, k + 1))
+		first_impact = std::min(first_impact, obstacle_impact(k));
+	if(first_impact > 1) return false;
+	
+	double last_hit(first_impact + simultaneous_impacts);
+	for(size_t j : candidates) {
+		if(player_impact(j) <= last_hit)
+			commands_.hit(j);
+	}
+	for(size_t k(Tools::mask_next(obstacle_mask, nb_obstacles, 0)); k < nb_obstacles; 
+		k = Tools::mask_next(obstacle_mask, nb_obstacles, k + 1)) {
+		if(obstacle_impact(k) <= last_hit)
+			commands_.remove_obstacle(map_.obstacle_key(k));
+	}
+	return true;
+}
+
+/**
+ * Several chunks per thread: chunks with many players looking for a path around 
+ * obstacles are slower, idle threads steal the remaining chunks of the busy ones.
+ * Never less than min_players_per_chunk players in a chunk.
+ */
+size_t Simulation::nb_player_chunks() const {
+	size_t nb_threads(Simulator::thread_pool().nb_threads());
+	if(nb_threads == 1) return 1;
+	
+	return std::max<size_t>(1, std::min(16 * nb_threads, 
+										players_.size() / min_players_per_chunk));
+}
+
+/**
+ * Chunk c holds the players [n*c/nb_chunks, n*(c+1)/nb_chunks). A single chunk calls
+ * the task directly, the pool only wraps it (in a std::function) for several.
+ */
+template <typename Task>
+void Simulation::for_each_player_chunk(size_t nb_chunks, const Task& task) {
+	size_t nb_players(players_.size());
+	if(nb_chunks == 1) {
+		task(0, 0, nb_players);
+		return;
 	}
+	Simulator::thread_pool().parallel_for(nb_chunks, [&](size_t chunk) {
+		task(chunk, nb_players * chunk / nb_chunks, nb_players * (chunk + 1) / nb_chunks);
+	});
 }
 
-bool Simulation::detect_ball_player_collision(const Ball& ball, const Player& player){
-	return Tools::intersect(ball.geometry(), player.body(), marge_jeu_);
+/**
+ * Returns room for a mask of "nb_elements" bits in the frame arena. It is not 
+ * cleared: the batch kernels of Tools overwrite the whole mask.
+ */
+Mask_Word* Simulation::scratch_mask(size_t nb_elements) {
+	return frame_arena_.allocate<Mask_Word>(Tools::mask_words(nb_elements) + 1);
 }
 
-bool Simulation::detect_ball_ball_collision(const Ball& first, const Ball& second) {
-	return Tools::intersect(first.geometry(), second.geometry(), marge_jeu_);
+/**
+ * A player throws at most one ball every max_count steps and a ball can't fly longer
+ * than the time it needs to cross the diagonal of the arena. Reserving for this
+ * many balls (and for the per step arrays) means that steady state updates never 
+ * reallocate. The frame arena is sized for the usual temporaries of a step. A ball
+ * too slow to cross in max_flight_steps steps (or that doesn't move) gets no bound,
+ * the pool is then only reserved for max_flight_steps and grows past it.
+ */
+void Simulation::reserve_ball_pool() {
+	double step_length(ball_speed_ * DELTA_T);
+	size_t flight_steps(step_length > SIDE * M_SQRT2 / max_flight_steps ?
+						std::ceil(SIDE * M_SQRT2 / step_length) : max_flight_steps);
+	size_t nb_balls(balls_.size() + players_.size() * (flight_steps/parameters_.max_count + 1));
+	
+	balls_.reserve(nb_balls);
+	ball_bodies_.reserve(nb_balls);
+	ball_circles_.reserve(nb_balls);
+	player_circles_.reserve(players_.size());
+	commands_.reserve(nb_balls, players_.size(), map_.nb_obstacles());
+	
+	size_t nb_mask_bytes(sizeof(Mask_Word) * (Tools::mask_words(nb_balls) + 
+											  Tools::mask_words(players_.size()) + 
+											  Tools::mask_words(map_.nb_obstacles()) + 
+											  3));
+	frame_arena_.reserve(2 * nb_mask_bytes + 
+						 sizeof(Index_Pair) * (map_.nb_obstacles() + 
+											   neighbor_number * players_.size()));
 }
 
 void Simulation::take_player_life(size_t &player_index) {
 	players_[player_index].take_life();
+	if(players_[player_index].lives() < 1 || players_[player_index].lives() > MAX_TOUCH)
+		commands_.death(player_index);
+}
+
+/**
+ * Applies all changes recorded during the step, then clears the record.
+ * Balls are spawned last so that the indexes of the other commands stay valid.
+ */
+void Simulation::apply_commands() {
+	
+	for(size_t player_index : commands_.hits())
+		take_player_life(player_index);
+	
+	remove_collided_balls();
+	remove_dead_players();
+	
+	commands_.unique_obstacle_removals();
+	remove_obstacles(commands_.obstacle_removals());
+	
+	for(const auto& spawn : commands_.spawns())
+		initialise_ball(spawn.position, spawn.direction);
+	
+	commands_.clear();
 }
 
 void Simulation::remove_collided_balls() {
@@ -945,6 +2545,9 @@ void Simulation::remove_collided_balls() {
 
 void Simulation::remove_dead_players() {
 	
+	if(commands_.deaths().empty()) return;
+	target_kept_until_.clear();		// indexes change
+	
 	size_t nb_players(players_.size());
 	
 	for (size_t i(0); i < nb_players;) {
@@ -958,10 +2561,16 @@ void Simulation::remove_dead_players() {
 	}
 }
 
-void Simulation::remove_obstacle(size_t x, size_t y) {
-	map_.remove_obstacle(x, y);
-	initialise_floyd_matrix();
-	update_floyd();
+/**
+ * The floyd matrix is rebuilt once for all removed obstacles.
+ */
+void Simulation::remove_obstacles(const std::vector<Index_Pair>& obstacles) {
+	if(obstacles.empty()) return;
+	
+	for(const auto& obstacle : obstacles)
+		map_.remove_obstacle(obstacle.first, obstacle.second);
+	nb_obstacles_destroyed_ += obstacles.size();
+	initialise_floyd_matrix();	// also runs update_floyd()
 }
 
 bool Simulation::initialise_obstacle(int x, int y, Counter counter){
@@ -1001,6 +2610,15 @@ bool Simulation::initialise_ball (double x, double y, Angle alpha){
 	return true;
 }
 
+bool Simulation::initialise_ball(Coordinate const& position, Vector const& direction){
+	if(test_center_position(position.x, position.y) == false){
+		std::cout << BALL_OUT(balls_.size() + 1) << std::endl;
+		return false;	
+	}
+	balls_.push_back(Ball(direction.get_unit(), ball_radius_, position));
+	return true;
+}
+
 bool Simulation::initialise_player (double x, double y, Counter lives, 
 									Counter cooldown){
 
@@ -1030,10 +2648,12 @@ void Simulation::nb_cells(size_t nb_cells){
 
 bool Simulation::detect_initial_player_collisions() const {
 	size_t nb_players = players_.size();
+	Length contact2(Tools::contact_squared(player_radius_, player_radius_, 
+										   marge_lecture_));
 	for(size_t i(0); i < nb_players; ++i) {
 		for(size_t j(i+1); j < nb_players; ++j) {
-			if(Tools::intersect((players_[j]).body(), (players_[i]).body(),
-								marge_lecture_)) {
+			if(Tools::overlap(players_[j].position(), players_[i].position(), 
+							  contact2)) {
 				std::cout << PLAYER_COLLISION(i+1, j+1) << std::endl;
 				return false;
 			}
@@ -1044,10 +2664,10 @@ bool Simulation::detect_initial_player_collisions() const {
  
 bool Simulation::detect_initial_ball_collisions() const {
 	size_t nb_balls = balls_.size();
+	Length contact2(Tools::contact_squared(ball_radius_, ball_radius_, marge_lecture_));
 	for(size_t i(0); i < nb_balls; ++i){
 		for(size_t j(i+1); j < nb_balls; j++){
-			if(Tools::intersect(balls_[i].geometry(), 
-								balls_[j].geometry(), marge_lecture_)){
+			if(Tools::overlap(balls_[i].position(), balls_[j].position(), contact2)){
 				std::cout << BALL_COLLISION(i+1,j+1) << std::endl;
 				return false;								
 			}	
@@ -1059,10 +2679,12 @@ bool Simulation::detect_initial_ball_collisions() const {
 bool Simulation::detect_all_ball_player_collisions() const {
 	size_t nb_balls = balls_.size();
 	size_t nb_players = players_.size();
+	Length contact2(Tools::contact_squared(player_radius_, ball_radius_, 
+										   marge_lecture_));
 	for(size_t i(0); i<nb_balls; ++i){
 		for(size_t j(0); j<nb_players; ++j){
-			if(Tools::intersect(players_[j].body(), 
-								balls_[i].geometry(), marge_lecture_)) {
+			if(Tools::overlap(players_[j].position(), balls_[i].position(), 
+							  contact2)) {
 				std::cout << PLAYER_BALL_COLLISION(j+1,i+1) << std::endl;
 				return false;					
 			}
@@ -1098,6 +2720,14 @@ bool Simulation::test_collisions() {
 	return true;
 }
 
+size_t Simulation::nb_steps() const {return nb_steps_;}
+
+size_t Simulation::nb_quiet_steps() const {return nb_quiet_steps_;}
+
+size_t Simulation::nb_obstacles_destroyed() const {return nb_obstacles_destroyed_;}
+
+const Simulation_Parameters& Simulation::parameters() const {return parameters_;}
+
 Simulation_State Simulation::state() const {
 	
 	return state_;
@@ -1108,47 +2738,472 @@ Simulation_State Simulation::state() const {
  * done in a straightforward way so there is no need for another class as in Reader.
  */
 bool Simulation::save(const std::string &o_file_path) const {
-	std::ofstream o_file(o_file_path);
-	if (!o_file) return false;
-	std::ostringstream os_stream;	//to reach the file only once at the end
-	
-	os_stream << "# nbCell" << "\n\t" << nb_cells_ << "\n\n";
-	
-	os_stream << "# number of players" << "\n\t" << players_.size() << "\n\n";
-	os_stream << "# position of players" << "\n\t";
-	for (auto const& player : players_) {
-		os_stream << player.body().center().x << "\t" << player.body().center().y;
-		os_stream << "\t" << player.lives() << "\t" << player.cooldown() << "\n\t";
-	}
-	os_stream << "\n";
-	
-	os_stream << "# nbObstacles" << "\n\t" << map_.nb_obstacles() << "\n\n";
-	os_stream << "# position of obstacles" << "\n";
-	for(size_t i(0); i < nb_cells_; ++i) {
-		for(size_t j(0); j < nb_cells_; ++j) {
-			if(map_.is_obstacle(i, j)) {
-				os_stream << "\t" << i << "\t" << j << "\n";
-			}
-		}
+	return write_state_file(State_View(*this, nb_cells_, map_.nb_obstacles(), 
+									   map_.obstacle_bitmap()), o_file_path);
+}
+
+void Simulation::save_state(Saved_State& state) const {
+	state.nb_cells = nb_cells_;
+	state.nb_obstacles = map_.nb_obstacles();
+	
+	state.players.clear();
+	state.players.reserve(players_.size());
+	for (size_t i(0); i < players_.size(); ++i)
+		state.players.push_back(player_record(i));
+	state.balls.clear();
+	state.balls.reserve(balls_.size());
+	for (size_t i(0); i < balls_.size(); ++i)
+		state.balls.push_back(ball_record(i));
+	state.obstacles = map_.obstacle_bitmap();
+}
+
+Snapshot::Player_Record Simulation::player_record(size_t index) const {
+	Player const& player(players_[index]);
+	return {player.body().center().x, player.body().center().y, player.lives(), 
+			player.cooldown()};
+}
+
+Snapshot::Ball_Record Simulation::ball_record(size_t index) const {
+	Ball const& ball(balls_[index]);
+	return {ball.geometry().center().x, ball.geometry().center().y, 
+			ball.direction().angle()};
+}
+
+void Simulation::save_rewind(Rewind_Snapshot& snapshot) const {
+	snapshot.nb_steps = nb_steps_;
+	snapshot.nb_obstacles_destroyed = nb_obstacles_destroyed_;
+	snapshot.state = state_;
+	snapshot.players = players_;
+	snapshot.balls = balls_;
+	snapshot.obstacles = map_.obstacle_bitmap();
+}
+
+/**
+ * What the steps keep from one step to the next besides the copy is recomputed: the
+ * targets of all players are searched again at the next step, and the distances of 
+ * Floyd if the obstacles differ (they are integers, so they don't depend on the
+ * order of the removals).
+ */
+bool Simulation::restore(Rewind_Snapshot const& snapshot) {
+	if(recorder_ != nullptr) return false;	//the recording can't go back
+	
+	nb_steps_ = snapshot.nb_steps;
+	nb_obstacles_destroyed_ = snapshot.nb_obstacles_destroyed;
+	state_ = snapshot.state;
+	players_ = snapshot.players;
+	balls_ = snapshot.balls;
+	for(auto& player : players_)
+		player.target(nullptr);
+	target_kept_until_.clear();
+	free_until_.clear();
+	
+	if(snapshot.obstacles != map_.obstacle_bitmap()) {
+		map_.initialise_map(nb_cells_);
+		size_t nb_bits(nb_cells_ * nb_cells_);
+		for(size_t bit(Tools::mask_next(snapshot.obstacles.data(), nb_bits, 0)); 
+			bit < nb_bits; 
+			bit = Tools::mask_next(snapshot.obstacles.data(), nb_bits, bit + 1))
+			map_.add_obstacle(bit / nb_cells_, bit % nb_cells_);
+		
+		for(auto& row : floyd_matrix_)
+			std::fill(row.begin(), row.end(), max_dist_);
+		initialise_floyd_matrix();
+	}
+	update_graphics();
+	return true;
+}
+
+
+
+
+void Simulation::write_positions(std::ostream& os) const {
+	os << players_.size() << "\t" << balls_.size() << "\n";
+	for(const auto& position : positions())
+		os << position.x << "\t" << position.y << "\n";
+}
+
+std::vector<Coordinate> Simulation::positions() const {
+	std::vector<Coordinate> all_positions;
+	all_positions.reserve(players_.size() + balls_.size());
+	for(const auto& player : players_)
+		all_positions.push_back(player.position());
+	for(const auto& ball : balls_)
+		all_positions.push_back(ball.position());
+	return all_positions;
+}
+
+
+
+
+/// ===== STEP COMMANDS ===== ///
+
+// ===== Accessors =====
+
+const std::vector<Ball_Spawn>& Step_Commands::spawns() const {return spawns_;}
+
+const std::vector<size_t>& Step_Commands::hits() const {return hits_;}
+
+const std::vector<Index_Pair>& Step_Commands::obstacle_removals() const {
+	return obstacle_removals_;
+}
+
+const std::vector<size_t>& Step_Commands::deaths() const {return deaths_;}
+
+bool Step_Commands::empty() const {
+	return spawns_.empty() && hits_.empty() && obstacle_removals_.empty() && 
+		   deaths_.empty();
+}
+
+// ===== Recorders =====
+
+void Step_Commands::spawn(Coordinate const& position, Vector const& direction) {
+	spawns_.push_back({position, direction});
+}
+
+void Step_Commands::open_spawn_buffers(size_t nb_chunks) {
+	if(spawn_buffers_.size() < nb_chunks)
+		spawn_buffers_.resize(nb_chunks);
+	for(size_t chunk(0); chunk < nb_chunks; ++chunk)
+		spawn_buffers_[chunk].clear();
+}
+
+std::vector<Ball_Spawn>& Step_Commands::spawn_buffer(size_t chunk) {
+	return spawn_buffers_[chunk];
+}
+
+void Step_Commands::merge_spawn_buffers() {
+	for(auto& buffer : spawn_buffers_) {
+		spawns_.insert(spawns_.end(), buffer.begin(), buffer.end());
+		buffer.clear();
+	}
+}
+
+void Step_Commands::hit(size_t player_index) {
+	hits_.push_back(player_index);
+}
+
+void Step_Commands::remove_obstacle(Index_Pair const& obstacle) {
+	obstacle_removals_.push_back(obstacle);
+}
+
+void Step_Commands::death(size_t player_index) {
+	deaths_.push_back(player_index);
+}
+
+// ===== Methods =====
+
+/**
+ * A ball hits every player it touches in the same step. Players don't overlap, so 
+ * with the radii of define.h at most 4 of them touch a ball (more can only come from
+ * other parameters, hits_ then grows once and keeps its capacity).
+ */
+void Step_Commands::reserve(size_t nb_balls, size_t nb_players, size_t nb_obstacles) {
+	spawns_.reserve(nb_players);
+	hits_.reserve(max_hits_per_ball * nb_balls);
+	obstacle_removals_.reserve(nb_obstacles);
+	deaths_.reserve(nb_players);
+}
+
+void Step_Commands::clear() {
+	spawns_.clear();
+	hits_.clear();
+	obstacle_removals_.clear();
+	deaths_.clear();
+}
+
+void Step_Commands::unique_obstacle_removals() {
+	std::sort(obstacle_removals_.begin(), obstacle_removals_.end());
+	obstacle_removals_.erase(std::unique(obstacle_removals_.begin(), 
+										 obstacle_removals_.end()),
+							 obstacle_removals_.end());
+}
+
+
+
+
+/// ===== REWIND RING ===== ///
+
+// ===== Constructor =====
+
+Rewind_Ring::Rewind_Ring() : slots_(rewind_capacity), first_(0), size_(0) {}
+
+// ===== Methods =====
+
+void Rewind_Ring::clear() {
+	first_ = 0;
+	size_ = 0;
+}
+
+Rewind_Snapshot& Rewind_Ring::push() {
+	if(size_ == slots_.size()) {
+		first_ = (first_ + 1) % slots_.size();
+		--size_;
+	}
+	return slot(size_++);
+}
+
+const Rewind_Snapshot* Rewind_Ring::find(size_t nb_steps) const {
+	for(size_t age_index(size_); age_index > 0; --age_index) {
+		if(slot(age_index - 1).nb_steps <= nb_steps)
+			return &slot(age_index - 1);
 	}
-	os_stream << "\n";
+	return nullptr;
+}
+
+void Rewind_Ring::drop_after(size_t nb_steps) {
+	while(size_ > 0 && slot(size_ - 1).nb_steps > nb_steps)
+		--size_;
+}
+
+Rewind_Snapshot& Rewind_Ring::slot(size_t age_index) {
+	return slots_[(first_ + age_index) % slots_.size()];
+}
+
+const Rewind_Snapshot& Rewind_Ring::slot(size_t age_index) const {
+	return slots_[(first_ + age_index) % slots_.size()];
+}
+
+
+
+
+/// ===== TEXT SCANNER ===== ///
+
+// ===== Constructor =====
+
+Text_Scanner::Text_Scanner(const char* begin, const char* end) : position_(begin),
+																 end_(end), 
+																 line_end_(begin) {}
+
+// ===== Methods =====
+
+/**
+ * Like getline(from >> std::ws, line) until the line doesn't start with '#'.
+ */
+bool Text_Scanner::next_data_line() {
+	do {
+		position_ = line_end_;
+		while(position_ != end_ && std::isspace(static_cast<unsigned char>(*position_)))
+			++position_;
+		if(position_ == end_) return false;
+		
+		line_end_ = std::find(position_, end_, '\n');
+	} while(*position_ == '#');
+	return true;
+}
+
+/**
+ * Goes to the beginning of the next value of the line, after its '+' sign if any
+ * (from_chars only accepts '-'). False for "+-", like the stream extraction.
+ */
+bool Text_Scanner::skip_to_value() {
+	while(position_ != line_end_ && 
+		  std::isspace(static_cast<unsigned char>(*position_)))
+		++position_;
+	if(position_ == line_end_ || *position_ != '+') return true;
 	
-	os_stream << "# nbBalls" << "\n\t" << balls_.size() << "\n\n";
-	os_stream << "# position of balls" << "\n\t";
-	for (auto const& ball : balls_) {
-		os_stream << ball.geometry().center().x << "\t" << ball.geometry().center().y;
-		os_stream << "\t" << ball.direction().angle() << "\n\t";	
+	++position_;
+	return position_ == line_end_ || *position_ != '-';
+}
+
+bool Text_Scanner::read_value(int& value) {
+	if(!skip_to_value()) return false;
+	std::from_chars_result result(std::from_chars(position_, line_end_, value));
+	position_ = result.ptr;
+	return result.ec == std::errc();
+}
+
+/**
+ * Like the stream extraction: a magnitude above the range of Counter is an error, a
+ * negative value in range wraps around.
+ */
+bool Text_Scanner::read_value(Counter& value) {
+	if(!skip_to_value()) return false;
+	bool negative(position_ != line_end_ && *position_ == '-');
+	Counter magnitude(0);
+	std::from_chars_result result(std::from_chars(negative ? position_ + 1 : position_,
+												  line_end_, magnitude));
+	position_ = result.ptr;
+	value = negative ? -magnitude : magnitude;
+	return result.ec == std::errc();
+}
+
+/**
+ * from_chars also accepts "inf" and "nan", which the stream extraction refuses.
+ */
+bool Text_Scanner::read_value(double& value) {
+	if(!skip_to_value()) return false;
+	const char* digits(position_ != line_end_ && *position_ == '-' ? position_ + 1 
+																	: position_);
+	if(digits != line_end_ && (*digits == 'i' || *digits == 'I' ||
+							   *digits == 'n' || *digits == 'N')) 
+		return false;
+	std::from_chars_result result(std::from_chars(position_, line_end_, value));
+	position_ = result.ptr;
+	return result.ec == std::errc();
+}
+
+
+/// ===== FILE WRITER ===== ///
+
+// ===== Constructor =====
+
+File_Writer::File_Writer(const std::string& file_path, std::ios::openmode mode) : 
+	file_(file_path, mode | std::ios::out), buffer_(new char[writer_buffer_size]), 
+	used_(0) {}
+
+// ===== Methods =====
+
+bool File_Writer::is_open() const {return file_.is_open();}
+
+File_Writer& File_Writer::operator<<(const char* text) {
+	write(text, std::strlen(text));
+	return *this;
+}
+
+File_Writer& File_Writer::operator<<(double value) {
+	reserve(max_number_chars);
+	used_ = std::to_chars(buffer_.get() + used_, buffer_.get() + writer_buffer_size, 
+						  value, std::chars_format::general, save_precision).ptr - 
+			buffer_.get();
+	return *this;
+}
+
+void File_Writer::write(const void* data, size_t size) {
+	const char* bytes(static_cast<const char*>(data));
+	while(size > 0) {
+		reserve(1);
+		size_t part(std::min(size, writer_buffer_size - used_));
+		std::memcpy(buffer_.get() + used_, bytes, part);
+		used_ += part;
+		bytes += part;
+		size -= part;
 	}
-	os_stream << "\n# file saved successfully";
+}
+
+bool File_Writer::close() {
+	flush();
+	file_.close();
+	return !file_.fail();
+}
+
+void File_Writer::reserve(size_t size) {
+	if(used_ + size > writer_buffer_size) flush();
+}
+
+void File_Writer::flush() {
+	file_.write(buffer_.get(), used_);
+	used_ = 0;
+}
+
+/// ===== STATE VIEW ===== ///
+
+// ===== Constructors =====
+
+State_View::State_View(Saved_State const& state) : saved_(&state), 
+	simulation_(nullptr), nb_cells_(state.nb_cells), nb_obstacles_(state.nb_obstacles),
+	obstacles_(state.obstacles) {}
+
+State_View::State_View(Simulation const& simulation, size_t nb_cells, 
+					   size_t nb_obstacles, const std::vector<Mask_Word>& obstacles) : 
+	saved_(nullptr), simulation_(&simulation), nb_cells_(nb_cells), 
+	nb_obstacles_(nb_obstacles), obstacles_(obstacles) {}
+
+// ===== Accessors =====
+
+size_t State_View::nb_cells() const {return nb_cells_;}
+
+size_t State_View::nb_obstacles() const {return nb_obstacles_;}
+
+size_t State_View::nb_players() const {
+	return saved_ ? saved_->players.size() : simulation_->players().size();
+}
+
+size_t State_View::nb_balls() const {
+	return saved_ ? saved_->balls.size() : simulation_->balls().size();
+}
+
+Snapshot::Player_Record State_View::player(size_t index) const {
+	return saved_ ? saved_->players[index] : simulation_->player_record(index);
+}
+
+Snapshot::Ball_Record State_View::ball(size_t index) const {
+	return saved_ ? saved_->balls[index] : simulation_->ball_record(index);
+}
+
+const std::vector<Mask_Word>& State_View::obstacles() const {return obstacles_;}
+
+// ===== File Formats =====
+
+/**
+ * Text format, or binary snapshot format for ".snap" paths (see snapshot.h).
+ */
+static bool write_state_file(State_View const& state, const std::string& o_file_path) {
+	if(Snapshot::is_snapshot_path(o_file_path))
+		return write_snapshot_file(state, o_file_path);
+	return write_text_file(state, o_file_path);
+}
+
+static bool write_text_file(State_View const& state, const std::string& o_file_path) {
+	File_Writer o_file(o_file_path, std::ios::out);
+	if (!o_file.is_open()) return false;
 	
-	o_file << os_stream.str();
-	if(!o_file) return false;
+	o_file << "# nbCell" << "\n\t" << state.nb_cells() << "\n\n";
 	
-	o_file.close();		
-	return true;
+	o_file << "# number of players" << "\n\t" << state.nb_players() << "\n\n";
+	o_file << "# position of players" << "\n\t";
+	for (size_t i(0); i < state.nb_players(); ++i) {
+		Snapshot::Player_Record player(state.player(i));
+		o_file << player.x << "\t" << player.y;
+		o_file << "\t" << player.lives << "\t" << player.cooldown << "\n\t";
+	}
+	o_file << "\n";
+	
+	o_file << "# nbObstacles" << "\n\t" << state.nb_obstacles() << "\n\n";
+	o_file << "# position of obstacles" << "\n";
+	const Mask_Word* obstacles(state.obstacles().data());
+	size_t nb_cells(state.nb_cells()), nb_bits(nb_cells * nb_cells);
+	for(size_t bit(Tools::mask_next(obstacles, nb_bits, 0)); bit < nb_bits;
+		bit = Tools::mask_next(obstacles, nb_bits, bit + 1)) {
+		o_file << "\t" << bit / nb_cells << "\t" << bit % nb_cells << "\n";
+	}
+	o_file << "\n";
+	
+	o_file << "# nbBalls" << "\n\t" << state.nb_balls() << "\n\n";
+	o_file << "# position of balls" << "\n\t";
+	for (size_t i(0); i < state.nb_balls(); ++i) {
+		Snapshot::Ball_Record ball(state.ball(i));
+		o_file << ball.x << "\t" << ball.y;
+		o_file << "\t" << ball.angle << "\n\t";	
+	}
+	o_file << "\n# file saved successfully";
+	
+	return o_file.close();
 }
 
-
+/**
+ * The records are written one by one, File_Writer gathers them in its buffer.
+ */
+static bool write_snapshot_file(State_View const& state, 
+								const std::string& o_file_path) {
+	File_Writer o_file(o_file_path, std::ios::binary);
+	if (!o_file.is_open()) return false;
+	
+	Snapshot::Header header(Snapshot::make_header(state.nb_cells(), state.nb_players(),
+												  state.nb_obstacles(), 
+												  state.nb_balls()));
+	o_file.write(&header, sizeof(header));
+	for (size_t i(0); i < state.nb_players(); ++i) {
+		Snapshot::Player_Record player(state.player(i));
+		o_file.write(&player, sizeof(player));
+	}
+	for (size_t i(0); i < state.nb_balls(); ++i) {
+		Snapshot::Ball_Record ball(state.ball(i));
+		o_file.write(&ball, sizeof(ball));
+	}
+	o_file.write(state.obstacles().data(), state.obstacles().size() * sizeof(Mask_Word));
+	
+	return o_file.close();
+}
 
 
 /// ===== READER ===== ///
@@ -1176,27 +3231,58 @@ void Reader::reader_state(ReaderState reader_state) {reader_state_ = reader_stat
  */
 bool Reader::import_file(std::string const& file_adress, Simulation& simulation) {
 
-	std::ifstream in_file(file_adress);
-	if(in_file.fail()) { //file reading is not possible, failbit occured
+	Mapped_File in_file(file_adress);
+	if(in_file.is_open() == false) { //not a regular file, read it as a stream
+		std::ifstream in_stream(file_adress);
+		if(in_stream.fail()) { //file reading is not possible, failbit occured
+			#ifndef NDEBUG
+			std::cout << "File : \"" << file_adress << "\" can't be read." 
+					  << std::endl;
+			#endif
+			return false;
+		}
+		return import_stream(in_stream, simulation);
+	}
+	
+	bool success(false);
+	if(Snapshot::is_snapshot(in_file.data(), in_file.size())) {
+		success = read_snapshot(in_file.data(), in_file.size(), simulation);
+	} else {
+		Text_Scanner scanner(in_file.data(), in_file.end());
+		success = read_file(scanner, simulation);
+	}
+	if(success == false){
 		#ifndef NDEBUG
-		std::cout << "File : \"" << file_adress << "\" can't be read." << std::endl;
+		print_error_state(reader_state_);
 		#endif
-		in_file.close();
 		return false;
 	}
-	if(read_file(in_file, simulation) == false){
+	return true;
+}
+
+
+/**
+ * Same as import_file for data already in memory (e.g. generated scenarios)
+ */
+bool Reader::import_stream(std::istream& in_data, Simulation& simulation) {
+	std::string data((std::istreambuf_iterator<char>(in_data)), 
+					 std::istreambuf_iterator<char>());
+	bool success(false);
+	if(Snapshot::is_snapshot(data.data(), data.size())) {
+		success = read_snapshot(data.data(), data.size(), simulation);
+	} else {
+		Text_Scanner scanner(data.data(), data.data() + data.size());
+		success = read_file(scanner, simulation);
+	}
+	if(success == false){
 		#ifndef NDEBUG
 		print_error_state(reader_state_);
 		#endif
-		in_file.close();
 		return false;
 	}
-	
-	in_file.close();
 	return true;
 }
 
-
 /**
  * Reads simulation data from "in_file" to given simulation starting from the given
  * state of the simulation.
@@ -1207,7 +3293,7 @@ bool Reader::import_file(std::string const& file_adress, Simulation& simulation)
  * 
  * Returns true if the reading is successful.
  */
-bool Reader::read_file(std::ifstream& in_file, Simulation& simulation, 
+bool Reader::read_file(Text_Scanner& in_file, Simulation& simulation, 
 					  bool only_one_state){
 		switch(reader_state_){
 			case BEGIN: reader_state_ = READ_NB_CELLS;
@@ -1251,22 +3337,6 @@ bool Reader::read_file(std::ifstream& in_file, Simulation& simulation,
 
 // ===== Private Static Methods =====
 
-/**
- * Sets the given string to the next line in file that possibly contains a data.
- * 
- * Returns true if the reading is succesful.
- */
-bool Reader::next_data_line(std::ifstream& from, std::string& data_line){
-	do {
-		if(!getline(from >> std::ws, data_line)){ //error? when reading the next line
-			return false;
-		}
-	}while(data_line[0]=='#');
-	//line containing possible data is in "data_line"
-	return true;
-}
-
-
 /**
  * Reads the data for the number of cells from the given file to the "simulation".
  * 
@@ -1275,13 +3345,11 @@ bool Reader::next_data_line(std::ifstream& from, std::string& data_line){
  * 
  * Numeric values and the grid a initialised after reading of "nb_cells"
  */
-bool Reader::read_nb_cells(std::ifstream& in_file, Simulation& simulation){
-	std::string line;
-	if(next_data_line(in_file,line) ==  false)
+bool Reader::read_nb_cells(Text_Scanner& in_file, Simulation& simulation){
+	if(in_file.next_data_line() ==  false)
 		return false;
 	int nb_cells(0);
-	std::istringstream i_string(line);
-	if(!(i_string >> nb_cells) || nb_cells<MIN_CELL || nb_cells>MAX_CELL) {
+	if(!in_file.read(nb_cells) || nb_cells<MIN_CELL || nb_cells>MAX_CELL) {
 		#ifndef NDEBUG
 		std::cout << "Invalid cell number: " << nb_cells << std::endl;
 		#endif
@@ -1297,13 +3365,11 @@ bool Reader::read_nb_cells(std::ifstream& in_file, Simulation& simulation){
  * The next data on "in_file" must be the data for the players when calling this
  * function.
  */
-bool Reader::read_players(std::ifstream& in_file, Simulation& simulation){
-	std::string line;
-	if(next_data_line(in_file, line) == false)
+bool Reader::read_players(Text_Scanner& in_file, Simulation& simulation){
+	if(in_file.next_data_line() == false)
 		return false;
 	int nb_players(0);
-	std::istringstream i_string(line);
-	if(!(i_string >> nb_players) || nb_players<0){
+	if(!in_file.read(nb_players) || nb_players<0){
 		#ifndef NDEBUG
 		std::cout << "Invalid number of players." << std::endl;
 		#endif
@@ -1315,12 +3381,9 @@ bool Reader::read_players(std::ifstream& in_file, Simulation& simulation){
 	Counter count(0);
 	
 	for(int i(0); i<nb_players; ++i){
-		if(!next_data_line(in_file, line)) return false;
+		if(!in_file.next_data_line()) return false;
 		
-		i_string.clear();
-		i_string.str(line);
-		
-		if(!(i_string >> x >> y >> nbt >> count)) return false;
+		if(!in_file.read(x, y, nbt, count)) return false;
 		if (simulation.initialise_player(x, y, nbt, count) == false) return false;
 	}
 	return true;
@@ -1332,13 +3395,11 @@ bool Reader::read_players(std::ifstream& in_file, Simulation& simulation){
  * The next data on "in_file" must be the data for the obstacles when calling this
  * function.
  */
-bool Reader::read_obstacles(std::ifstream& in_file, Simulation& simulation){
-	std::string line;
-	if(next_data_line(in_file,line) == false) return false;
+bool Reader::read_obstacles(Text_Scanner& in_file, Simulation& simulation){
+	if(in_file.next_data_line() == false) return false;
 	
-	std::istringstream i_string(line);
 	int nb_obstacles(0);
-	if(!(i_string >> nb_obstacles) || nb_obstacles < 0){
+	if(!in_file.read(nb_obstacles) || nb_obstacles < 0){
 		#ifndef NDEBUG
 		std::cout << "Invalid nb obstacles : " << std::endl; //for debugging
 		#endif
@@ -1347,12 +3408,9 @@ bool Reader::read_obstacles(std::ifstream& in_file, Simulation& simulation){
 		
 	int x(0), y(0);
 	for(int i(0); i < nb_obstacles; ++i) {
-		if(next_data_line(in_file,line) == false) return false;
-		
-		i_string.clear();
-		i_string.str(line);
+		if(in_file.next_data_line() == false) return false;
 		
-		if(!(i_string >> x >> y)) return false; //line and column
+		if(!in_file.read(x, y)) return false; //line and column
 		if (simulation.initialise_obstacle(x, y, (i+1)) == false) return false;
 	}
 	
@@ -1365,31 +3423,98 @@ bool Reader::read_obstacles(std::ifstream& in_file, Simulation& simulation){
  * The next data on "in_file" must be the data for the balls when calling this
  * function.
  */
-bool Reader::read_balls(std::ifstream& in_file, Simulation& simulation){
-	std::string line;
-	if(next_data_line(in_file,line) == false) return false;
+bool Reader::read_balls(Text_Scanner& in_file, Simulation& simulation){
+	if(in_file.next_data_line() == false) return false;
 	
-	std::istringstream i_string(line);
 	int nb_balls(0);
-	if(!(i_string >> nb_balls)){
+	if(!in_file.read(nb_balls)){
 		return false;
 	}
 	
 	double x(0), y(0);
 	double angle(0);
 	for(int i(0); i < nb_balls; ++i) {
-		if(next_data_line(in_file,line) == false) return false;
-	
-		i_string.clear();
-		i_string.str(line);
+		if(in_file.next_data_line() == false) return false;
 		
-		if(!(i_string >> x >> y >> angle)) return false; //line and column
+		if(!in_file.read(x, y, angle)) return false;
 		if (simulation.initialise_ball(x, y, angle) == false) return false;
 	}	
 	return true;
 	
 }
 
+/**
+ * The records are copied out of the data as they are (no parsing) but go through the
+ * same checks as the text format. Fails on another version or byte order of the 
+ * format and on a size not matching the counts of the header.
+ */
+bool Reader::read_snapshot(const char* data, size_t size, Simulation& simulation) {
+	reader_state_ = READ_NB_CELLS;
+	Snapshot::Header header;
+	if(size < sizeof(header)) return false;
+	std::memcpy(&header, data, sizeof(header));
+	
+	if(header.version != Snapshot::version || 
+	   header.byte_order != Snapshot::byte_order_mark) {
+		#ifndef NDEBUG
+		std::cout << "Unsupported snapshot version: " << header.version << std::endl;
+		#endif
+		return false;
+	}
+	if(header.nb_cells < MIN_CELL || header.nb_cells > MAX_CELL) {
+		#ifndef NDEBUG
+		std::cout << "Invalid cell number: " << header.nb_cells << std::endl;
+		#endif
+		return false;
+	}
+	if(size != Snapshot::file_size(header)) {
+		#ifndef NDEBUG
+		std::cout << "Snapshot size doesn't match its header." << std::endl;
+		#endif
+		return false;
+	}
+	simulation.initialise_dimensions(header.nb_cells);
+	const char* record(data + sizeof(header));
+	
+	reader_state_ = READ_PLAYERS;
+	Snapshot::Player_Record player;
+	for(size_t i(0); i < header.nb_players; ++i, record += sizeof(player)) {
+		std::memcpy(&player, record, sizeof(player));
+		if(simulation.initialise_player(player.x, player.y, player.lives, 
+										player.cooldown) == false) 
+			return false;
+	}
+	
+	Snapshot::Ball_Record ball;
+	const char* balls(record);
+	record += header.nb_balls * sizeof(ball);
+	
+	reader_state_ = READ_OBSTACLES;
+	size_t nb_bits(header.nb_cells * header.nb_cells);
+	std::vector<Mask_Word> bitmap(Snapshot::bitmap_words(header.nb_cells));
+	std::memcpy(bitmap.data(), record, bitmap.size() * sizeof(Mask_Word));
+	Counter nb_obstacles(0);
+	for(size_t bit(Tools::mask_next(bitmap.data(), nb_bits, 0)); bit < nb_bits;
+		bit = Tools::mask_next(bitmap.data(), nb_bits, bit + 1)) {
+		if(simulation.initialise_obstacle(bit / header.nb_cells, bit % header.nb_cells,
+										  ++nb_obstacles) == false) 
+			return false;
+	}
+	if(nb_obstacles != header.nb_obstacles) return false;
+	
+	reader_state_ = READ_BALLS;
+	for(size_t i(0); i < header.nb_balls; ++i, balls += sizeof(ball)) {
+		std::memcpy(&ball, balls, sizeof(ball));
+		if(simulation.initialise_ball(ball.x, ball.y, ball.angle) == false) 
+			return false;
+	}
+	
+	reader_state_ = SUCCESS;
+	if(simulation.test_collisions() == false) return false;
+	std::cout << FILE_READING_SUCCESS << std::endl;
+	return true;
+}
+
 void Reader::finalise_reading(ReaderState &actual_state) {
 	actual_state=SUCCESS; 
 	std::cout << FILE_READING_SUCCESS << std::endl;
@@ -9,11 +9,18 @@
 #define SIMULATION_H_INCLUDED
 
 #include "tools.h"
+#include "define.h"
+#include "snapshot.h"
 #include <string>
 #include <vector>
 #include <unordered_map>
 #include <memory>
 #include <tuple>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <future>
+#include <functional>
 
 /**
  * Enumeration of colors that will be used to determine player colors with respect to
@@ -46,9 +53,64 @@ typedef std::vector<std::tuple<const Circle*, Angle,
 typedef std::vector<const Circle*>		vec_ball_bodies;
 typedef std::vector<const Rectangle*>	vec_obstacle_bodies;
 
+/**
+ * Copy of everything the gui draws, taken after a step. Unlike the vectors above it
+ * doesn't point into the simulation, so it stays valid while the next steps run.
+ */
+struct Render_Snapshot {
+	Simulation_State state = NO_GAME;
+	size_t nb_steps = 0;
+	std::vector<std::tuple<Circle, Angle, Predefined_Color>> players;
+	std::vector<Circle> balls;
+	std::vector<Rectangle> obstacles;
+};
+
+
+/**
+ * Everything a saved file holds, as the records of the binary format (snapshot.h).
+ * Taking it only copies arrays, the file can then be written on another thread.
+ */
+struct Saved_State {
+	size_t nb_cells = 0;
+	size_t nb_obstacles = 0;
+	std::vector<Snapshot::Player_Record> players;
+	std::vector<Snapshot::Ball_Record> balls;
+	std::vector<Mask_Word> obstacles;	//bitmap of Map
+};
+
+
+/**
+ * Arena parameters of a simulation, sizes and speeds are given relative to the side 
+ * of a cell. The defaults are the constants of define.h, the ensemble runner 
+ * (ensemble.h) changes them to compare different arenas.
+ */
+struct Simulation_Parameters {
+	double coef_player_radius = COEF_RAYON_JOUEUR;
+	double coef_player_speed = COEF_VITESSE_JOUEUR;
+	double coef_ball_radius = COEF_RAYON_BALLE;
+	double coef_ball_speed = COEF_VITESSE_BALLE;
+	double coef_marge_jeu = COEF_MARGE_JEU;
+	Counter max_count = MAX_COUNT;	//steps between two throws of a player
+	bool swept_balls = false;		//continuous ball collisions (see simulation.cc)
+};
+
+/**
+ * Outcome of a headless run (see Simulator::run_scenarios)
+ */
+struct Run_Result {
+	bool loaded = false;
+	Simulation_State state = NO_GAME;
+	size_t nb_steps = 0;
+	size_t nb_survivors = 0;
+	size_t nb_balls = 0;
+	size_t nb_obstacles_destroyed = 0;
+};
 
 
 class Simulation; //forward declaration necessary
+class Thread_Pool;
+class Rewind_Ring;
+template <typename T> class Triple_Buffer;
 /**
  * This is a helper class to make it possible to move the declaration of Simulation 
  * to .cc file. This way we do not need to include (and thus export) the inner modules.
@@ -62,6 +124,14 @@ class Simulator{
 		/// sets execution parameters to be used for all simulation objects
 		static void exec_parameters(const std::unordered_map<std::string, bool>&);
 		
+		/**
+		 * Number of threads stepping the simulations (0: one per hardware thread).
+		 * A single simulation uses them for its player phases, several simulations 
+		 * are stepped one per thread.
+		 */
+		static void nb_threads(size_t nb_threads);
+		static void print_thread_statistics();
+		
 		/// corresponding accessor
 		static const std::unordered_map<std::string, bool>& exec_parameters();
 	
@@ -71,10 +141,22 @@ class Simulator{
 		 */
 		static bool create_simulation(std::vector<std::string> const& io_files);							  
 		
+		/// loads one more simulation, the active simulation stays the same
+		static bool add_simulation(std::vector<std::string> const& io_files);
+		
 		static bool import_file(const std::string&);
 		static bool empty();
+		static size_t nb_simulations();
 		static Simulation_State active_simulation_state();
 		
+		/**
+		 * Status and results of the simulation at "index" (0 to nb_simulations()-1)
+		 */
+		static Simulation_State simulation_state(size_t index);
+		static size_t simulation_steps(size_t index);
+		static size_t simulation_players(size_t index);
+		static size_t simulation_balls(size_t index);
+		
 		/**
 		 * Accessors to simulation's geometry 
 		 */							  			
@@ -82,10 +164,99 @@ class Simulator{
 		static const vec_ball_bodies& fetch_ball_bodies();
 		static const vec_obstacle_bodies& fetch_obstacle_bodies();
 		
+		/**
+		 * Simulation thread of the gui: the active simulation is stepped every 
+		 * DELTA_T on its own thread, which publishes a snapshot after each step. 
+		 * It stops by itself when the game is not ready anymore. While it runs, the
+		 * active simulation must only be read through fetch_snapshot(), anything 
+		 * else (step, save, open) needs stop_sim_thread() first.
+		 */
+		static bool start_sim_thread();
+		static bool stop_sim_thread();	//false if it wasn't running
+		
+		/**
+		 * Fast mode of the simulation thread (can be changed while it runs): steps 
+		 * as fast as possible instead of one per DELTA_T, and publishes one snapshot
+		 * per frame of the gui instead of one per step.
+		 */
+		static void fast_mode(bool);
+		
+		/// latest snapshot of the active simulation, to be called from the gui thread
+		static const Render_Snapshot& fetch_snapshot();
+		
 		static void update_active_sim(double delta_t);
+		
+		/**
+		 * Rewind of the active simulation: while it is stepped by the gui or the 
+		 * simulation thread, a copy of it is kept every few steps (a fixed number of 
+		 * copies, the oldest are dropped). step_back restores the last copy at or 
+		 * before "nb_steps" steps ago and runs the steps in between again. The 
+		 * simulation thread must not run. False if the copies don't go back that far.
+		 */
+		static bool step_back(size_t nb_steps = 1);
 		static void update_all_sims(double delta_t);
+		static void run_all_sims(size_t nb_steps);
+		
+		/**
+		 * Runs each scenario (input file format, in memory) with each parameter set
+		 * in parallel, without keeping the simulations. See simulation.cc for the 
+		 * order of the results.
+		 */
+		static std::vector<Run_Result> run_scenarios(
+							std::vector<std::string> const& scenarios,
+							std::vector<Simulation_Parameters> const& parameter_sets,
+							size_t nb_steps);
 		
 		static void save_simulation(const std::string&);
+		static bool save_simulation(size_t index, const std::string&);
+		
+		/**
+		 * Saves the active simulation on a background thread. Its state is copied 
+		 * between two steps (by the simulation thread while it runs, which doesn't
+		 * stop), then written by the saving thread. "on_saved" is called on the 
+		 * saving thread with the result. Returns false if the previous save is 
+		 * still running or there is no simulation.
+		 */
+		static bool save_in_background(const std::string&, 
+									   std::function<void(bool)> on_saved);
+		static void finish_save();	//waits for the background save
+		
+		/// writes a copy of a simulation, in the format given by the path
+		static bool write_state(Saved_State const&, const std::string&);
+		
+		/**
+		 * Bodies of a copy of a simulation (a frame of a replay, see trajectory.h), 
+		 * drawn like those of a loaded simulation with the default parameters.
+		 * nb_steps of the snapshot is left to the caller.
+		 */
+		static void fill_snapshot(Saved_State const&, Render_Snapshot&);
+		
+		/**
+		 * Records the active simulation to a trajectory file (see trajectory.h): its
+		 * current state, then its state after each step until stop_recording().
+		 */
+		static bool start_recording(const std::string&);
+		static bool stop_recording();	//false if a write failed
+		
+		/**
+		 * Headless run of the active simulation: runs "nb_steps" steps (or until the
+		 * game is over / a player is trapped) as fast as possible, prints the wall 
+		 * time and steps per second, then saves the final state to "o_file_path".
+		 */
+		static bool run_batch(const std::string& o_file_path, size_t nb_steps);
+		
+		/**
+		 * Validation of reduced precision builds (SCALAR=float, see tools.h).
+		 * 
+		 * write_trajectory runs the active simulation for "nb_steps" steps and writes
+		 * the positions of all players and balls after each step to "file_path".
+		 * compare_trajectory runs the same steps and compares the positions with a
+		 * file written by another build, printing the largest deviation. Returns 
+		 * false if the file can't be read or if the two runs stop having the same 
+		 * number of players/balls.
+		 */
+		static bool write_trajectory(const std::string& file_path, size_t nb_steps);
+		static bool compare_trajectory(const std::string& file_path, size_t nb_steps);
 	
 	private:
 		
@@ -101,6 +272,34 @@ class Simulator{
 		static size_t& current_sim_index();
 		static std::unordered_map<std::string, bool>& execution_parameters();
 		static std::vector<Simulation>& active_sims();
+		static std::unique_ptr<Thread_Pool>& thread_pool_holder();
+		static Thread_Pool& thread_pool();
+		
+		static Triple_Buffer<Render_Snapshot>& snapshot_buffer();
+		static void publish_snapshot();
+		static std::thread& sim_thread();
+		static std::atomic<bool>& sim_thread_stop();
+		static std::atomic<bool>& fast_mode_flag();
+		static void run_sim_thread();
+		
+		/**
+		 * Copies of the active simulation asked to the simulation thread. It takes
+		 * them between two steps as long as sim_thread_serving() (under the mutex).
+		 */
+		static std::mutex& capture_mutex();
+		static std::vector<std::promise<Saved_State>>& capture_requests();
+		static bool& sim_thread_serving();
+		static std::atomic<bool>& capture_requested();
+		static void serve_captures();
+		
+		static std::thread& save_thread();
+		static std::atomic<bool>& saving_flag();
+		
+		/// copies of the active simulation for step_back, kept after each step
+		static Rewind_Ring& rewind_ring();
+		static void keep_rewind_copy(const Simulation&);
+		
+		friend class Simulation;	//uses the thread pool
 
 };	
 
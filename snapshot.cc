@@ -0,0 +1,45 @@
+/**
+ * file: snapshot.cc
+ * 
+ * authors:	Cem Keske
+ * 			Emre Yazici
+ */
+#include "snapshot.h"
+#include <cstring>
+
+static const std::string snapshot_extension(".snap");
+
+/// ===== SNAPSHOT FORMAT ===== ///
+
+bool Snapshot::is_snapshot_path(const std::string& file_path) {
+	return file_path.size() >= snapshot_extension.size() &&
+		   file_path.compare(file_path.size() - snapshot_extension.size(), 
+							 snapshot_extension.size(), snapshot_extension) == 0;
+}
+
+bool Snapshot::is_snapshot(const char* data, size_t size) {
+	return size >= sizeof(magic) && std::memcmp(data, magic, sizeof(magic)) == 0;
+}
+
+Snapshot::Header Snapshot::make_header(size_t nb_cells, size_t nb_players, 
+									   size_t nb_obstacles, size_t nb_balls) {
+	Header header;
+	std::memcpy(header.magic, magic, sizeof(magic));
+	header.version = version;
+	header.byte_order = byte_order_mark;
+	header.nb_cells = nb_cells;
+	header.nb_players = nb_players;
+	header.nb_obstacles = nb_obstacles;
+	header.nb_balls = nb_balls;
+	return header;
+}
+
+size_t Snapshot::file_size(Header const& header) {
+	return sizeof(Header) + header.nb_players * sizeof(Player_Record) + 
+		   header.nb_balls * sizeof(Ball_Record) + 
+		   bitmap_words(header.nb_cells) * sizeof(Mask_Word);
+}
+
+size_t Snapshot::bitmap_words(size_t nb_cells) {
+	return Tools::mask_words(nb_cells * nb_cells);
+}
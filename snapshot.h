@@ -0,0 +1,76 @@
+/**
+ * file: snapshot.h
+ * 
+ * authors:	Cem Keske
+ * 			Emre Yazici
+ */
+#ifndef SNAPSHOT_H_INCLUDED
+#define SNAPSHOT_H_INCLUDED
+
+#include "tools.h"
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+/// SNAPSHOT FORMAT ///
+/**
+ * Binary file format of a simulation state (".snap" files), holding the same data as
+ * the text format. Nothing has to be parsed: the file is mapped (Mapped_File) and 
+ * its records are read in place. Layout, in native byte order:
+ * 
+ *	Header
+ *	Player_Record	x nb_players
+ *	Ball_Record		x nb_balls
+ *	Mask_Word		x Tools::mask_words(nb_cells * nb_cells), obstacle bitmap of Map
+ *					(bit line * nb_cells + col is set for an obstacle)
+ * 
+ * Coordinates are stored as double whatever the SCALAR of the build, so a snapshot
+ * keeps the exact state where the text format rounds to 6 digits.
+ */
+namespace Snapshot {
+	
+	constexpr char magic[8] = {'D', 'O', 'D', 'G', 'E', 'S', 'N', 'P'};
+	constexpr uint32_t version = 1;
+	constexpr uint32_t byte_order_mark = 0x01020304;	//reads differently if swapped
+	
+	struct Header {
+		char magic[8];
+		uint32_t version;
+		uint32_t byte_order;
+		uint32_t nb_cells;
+		uint32_t nb_players;
+		uint32_t nb_obstacles;
+		uint32_t nb_balls;
+	};
+	
+	struct Player_Record {
+		double x;
+		double y;
+		uint32_t lives;
+		uint32_t cooldown;
+	};
+	
+	struct Ball_Record {
+		double x;
+		double y;
+		double angle;
+	};
+	
+	static_assert(sizeof(Header) == 32 && sizeof(Player_Record) == 24 && 
+				  sizeof(Ball_Record) == 24, "snapshot records must not be padded");
+	
+	/// paths ending with ".snap" are saved in this format
+	bool is_snapshot_path(const std::string& file_path);
+	
+	/// true if the data starts with the magic of the format (any version)
+	bool is_snapshot(const char* data, size_t size);
+	
+	Header make_header(size_t nb_cells, size_t nb_players, size_t nb_obstacles,
+					   size_t nb_balls);
+	
+	/// size of a file with the counts of "header"
+	size_t file_size(Header const& header);
+	size_t bitmap_words(size_t nb_cells);
+}
+
+#endif
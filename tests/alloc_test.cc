@@ -0,0 +1,90 @@
+/**
+ * file: tests/alloc_test.cc
+ *
+ * authors:	Cem Keske
+ * 			Emre Yazici
+ */
+#include "simulation.h"
+#include <iostream>
+#include <cstdlib>
+#include <new>
+
+/**
+ * Counts the heap allocations of steady-state steps: the last nb_counted_steps steps
+ * of each scenario, run on one thread, must not allocate (buffers are reused from 
+ * step to step, scratch memory comes from the frame arena). A first run finds the 
+ * length of the game, the second one counts.
+ */
+
+static constexpr size_t nb_counted_steps(50);
+static constexpr size_t max_steps(100000);
+static constexpr double delta_t(0.0625);
+
+static const char* const scenarios[] = {"SimFİleGenerator/1000Players.txt",
+										"SimFİleGenerator/BallRotate.txt",
+										"SimFİleGenerator/deneme2.txt"};
+
+static size_t nb_allocations(0);
+static bool counting(false);
+
+void* operator new(size_t size) {
+	if(counting) ++nb_allocations;
+	void* memory(std::malloc(size > 0 ? size : 1));
+	if(memory == nullptr) throw std::bad_alloc();
+	return memory;
+}
+
+void* operator new[](size_t size) {
+	return operator new(size);
+}
+
+void operator delete(void* memory) noexcept {std::free(memory);}
+void operator delete[](void* memory) noexcept {std::free(memory);}
+void operator delete(void* memory, size_t) noexcept {std::free(memory);}
+void operator delete[](void* memory, size_t) noexcept {std::free(memory);}
+
+int main() {
+	Simulator::exec_parameters({{"Error", false}, {"Step", false}});
+	Simulator::nb_threads(1);
+
+	size_t nb_failures(0);
+	for(const char* scenario : scenarios) {
+		if(Simulator::create_simulation({scenario}) == false) {
+			std::cout << scenario << ": can't be loaded" << std::endl;
+			++nb_failures;
+			continue;
+		}
+		Simulator::run_all_sims(max_steps);
+		size_t nb_steps(Simulator::simulation_steps(0));
+		if(nb_steps < nb_counted_steps) {
+			std::cout << scenario << ": game over after " << nb_steps << " steps"
+					  << std::endl;
+			++nb_failures;
+			continue;
+		}
+
+		Simulator::create_simulation({scenario});
+		for(size_t i(0); i < nb_steps - nb_counted_steps; ++i)
+			Simulator::update_all_sims(delta_t);
+
+		nb_allocations = 0;
+		counting = true;
+		for(size_t i(0); i < nb_counted_steps; ++i)
+			Simulator::update_all_sims(delta_t);
+		counting = false;
+
+		if(nb_allocations > 0) {
+			std::cout << scenario << ": " << nb_allocations << " allocations in "
+					  << nb_counted_steps << " steps" << std::endl;
+			++nb_failures;
+		}
+	}
+
+	if(nb_failures > 0) {
+		std::cout << "alloc_test: " << nb_failures << " failures" << std::endl;
+		return EXIT_FAILURE;
+	}
+	std::cout << "alloc_test: no allocation in " << nb_counted_steps
+			  << " steady-state steps" << std::endl;
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,119 @@
+/**
+ * file: tests/contact_bench.cc
+ *
+ * authors:	Cem Keske
+ * 			Emre Yazici
+ */
+#include "tools.h"
+#include <cmath>
+#include <random>
+#include <chrono>
+#include <iostream>
+#include <cstdlib>
+
+/**
+ * Circle-circle tests of all pairs of nb_circles circles spread like the players of
+ * a crowded game, with the circle test as it was before squared distances (sqrt and
+ * tolerance branch per test), Tools::intersect, overlap() with a precomputed contact
+ * and the batch kernel. All must find the same number of contacts.
+ */
+
+static constexpr size_t nb_circles(2000);
+static constexpr size_t nb_repetitions(5);
+static constexpr Length radius(10);
+static constexpr Length tolerance(-0.5);
+
+/// Tools::intersect before the squared distances
+static bool sqrt_intersect(Circle const& one, Circle const& two, Length tolerance) {
+	if(tolerance < 0) tolerance = -tolerance;
+	Length sum_of_r(one.radius() + two.radius());
+	return one.center().distance(two.center()) <= sum_of_r + tolerance;
+}
+
+/// best time over the repetitions in ns per test, "nb_contacts" of the last one
+template <typename Test>
+static double time_tests(Test const& test, size_t& nb_contacts) {
+	double best(1e300);
+	for(size_t repetition(0); repetition < nb_repetitions; ++repetition) {
+		auto start(std::chrono::steady_clock::now());
+		nb_contacts = test();
+		std::chrono::duration<double, std::nano> elapsed(
+											std::chrono::steady_clock::now() - start);
+		best = std::min(best, elapsed.count() / (nb_circles * nb_circles));
+	}
+	return best;
+}
+
+int main() {
+	//a SIGNED overlap larger than the radii leaves no contact at a distance
+	Length no_contact(Tools::contact_squared<Tools::Tolerance_Policy::SIGNED>(
+															radius, radius, -3 * radius));
+	if(no_contact != 0 || Tools::overlap({0, 0}, {radius, 0}, no_contact)) {
+		std::cout << "Negative contact distance gives a contact" << std::endl;
+		return EXIT_FAILURE;
+	}
+	
+	std::mt19937 generator(7);
+	std::uniform_real_distribution<double> positions(-400, 400);
+	std::vector<Circle> circles;
+	Circle_Arrays arrays;
+	for(size_t i(0); i < nb_circles; ++i) {
+		circles.emplace_back(Coordinate(positions(generator), positions(generator)),
+							 radius);
+		arrays.push_back(circles.back());
+	}
+
+	size_t sqrt_contacts(0), intersect_contacts(0), overlap_contacts(0);
+	size_t batch_contacts(0);
+
+	double sqrt_time(time_tests([&circles] {
+		size_t nb_contacts(0);
+		for(auto const& one : circles)
+			for(auto const& two : circles)
+				nb_contacts += sqrt_intersect(one, two, tolerance);
+		return nb_contacts;
+	}, sqrt_contacts));
+
+	double intersect_time(time_tests([&circles] {
+		size_t nb_contacts(0);
+		for(auto const& one : circles)
+			for(auto const& two : circles)
+				nb_contacts += Tools::intersect(one, two, tolerance);
+		return nb_contacts;
+	}, intersect_contacts));
+
+	double overlap_time(time_tests([&circles] {
+		size_t nb_contacts(0);
+		Length contact2(Tools::contact_squared(radius, radius, tolerance));
+		for(auto const& one : circles)
+			for(auto const& two : circles)
+				nb_contacts += Tools::overlap(one.center(), two.center(), contact2);
+		return nb_contacts;
+	}, overlap_contacts));
+
+	std::vector<Mask_Word> mask(Tools::mask_words(nb_circles));
+	double batch_time(time_tests([&circles, &arrays, &mask] {
+		size_t nb_contacts(0);
+		Length contact2(Tools::contact_squared(radius, radius, tolerance));
+		for(auto const& one : circles) {
+			Tools::overlap(one.center(), arrays.span(), contact2, mask.data());
+			for(Mask_Word word : mask)
+				nb_contacts += __builtin_popcountll(word);
+		}
+		return nb_contacts;
+	}, batch_contacts));
+
+	std::cout << "ns per circle test (" << nb_circles << " circles, all pairs)\n"
+			  << "  sqrt and branch:       " << sqrt_time << "\n"
+			  << "  Tools::intersect:      " << intersect_time << "\n"
+			  << "  overlap, precomputed:  " << overlap_time << "\n"
+			  << "  batch kernel (SSE2):   " << batch_time << std::endl;
+
+	if(intersect_contacts != sqrt_contacts || overlap_contacts != sqrt_contacts ||
+	   batch_contacts != sqrt_contacts) {
+		std::cout << "Contacts differ: " << sqrt_contacts << " " << intersect_contacts
+				  << " " << overlap_contacts << " " << batch_contacts << std::endl;
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
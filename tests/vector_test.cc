@@ -0,0 +1,92 @@
+/**
+ * file: tests/vector_test.cc
+ *
+ * authors:	Cem Keske
+ * 			Emre Yazici
+ */
+#include "tools.h"
+#include <cmath>
+#include <random>
+#include <iostream>
+#include <cstdlib>
+#include <type_traits>
+
+/**
+ * Compares the trig-free operations of Vector (get_unit, get_perpendicular,
+ * get_rotated, rotate) with the same operations computed through angle() and
+ * Vector(Angle), as they were before. Results are compared relative to the length of
+ * the vector, within "tolerance" (a few float roundings in the SCALAR=float build, 
+ * where results are stored in single precision).
+ */
+
+static constexpr double tolerance(std::is_same<Scalar, float>::value ? 1e-6 : 1e-12);
+static constexpr size_t nb_random_vectors(100000);
+
+static size_t nb_failures(0);
+
+static void check_close(Vector const& trig_free, Vector const& trig, double scale,
+						const char* operation, Vector const& input) {
+	double error(std::max(std::abs(trig_free.pointed().x - trig.pointed().x),
+						  std::abs(trig_free.pointed().y - trig.pointed().y)) / scale);
+	if(error > tolerance) {
+		if(nb_failures < 10)
+			std::cout << operation << " of " << input.to_string() << ": "
+					  << trig_free.to_string() << " instead of " << trig.to_string()
+					  << " (relative error " << error << ")" << std::endl;
+		++nb_failures;
+	}
+}
+
+static void check_vector(Vector const& vector, Vector const& rotation) {
+	Length length(vector.length());
+	Angle angle(vector.angle());
+
+	check_close(vector.get_unit(), Vector(angle), 1, "get_unit", vector);
+	check_close(vector.get_perpendicular(), Vector(angle + M_PI_2), 1,
+				"get_perpendicular", vector);
+
+	Vector trig_rotated(Vector(angle + rotation.angle()) * length);
+	check_close(vector.get_rotated(rotation), trig_rotated, length, "get_rotated",
+				vector);
+	Vector rotated(vector);
+	rotated.rotate(rotation);
+	check_close(rotated, trig_rotated, length, "rotate", vector);
+
+	Vector unit(vector);
+	unit.make_unit();
+	check_close(unit, Vector(angle), 1, "make_unit", vector);
+}
+
+int main() {
+	//axes and diagonals, where atan2 is exact
+	for(int i(-1); i <= 1; ++i) {
+		for(int j(-1); j <= 1; ++j) {
+			if(i != 0 || j != 0)
+				check_vector(Vector(i, j), Vector(M_PI / 3));
+		}
+	}
+
+	std::mt19937 generator(2024);
+	std::uniform_real_distribution<double> angles(-M_PI, M_PI);
+	std::uniform_real_distribution<double> exponents(-6, 6);
+	for(size_t i(0); i < nb_random_vectors; ++i) {
+		Vector vector(Vector(angles(generator)) * std::pow(10., exponents(generator)));
+		check_vector(vector, Vector(angles(generator)));
+	}
+
+	//no direction: the unit and perpendicular vectors are null
+	Vector null_vector(0, 0);
+	if(null_vector.get_unit().length_squared() != 0 ||
+	   null_vector.get_perpendicular().length_squared() != 0) {
+		std::cout << "Null vector has a direction" << std::endl;
+		++nb_failures;
+	}
+
+	if(nb_failures > 0) {
+		std::cout << "vector_test: " << nb_failures << " failures" << std::endl;
+		return EXIT_FAILURE;
+	}
+	std::cout << "vector_test: trig-free results within " << tolerance
+			  << " of the trigonometric ones" << std::endl;
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,190 @@
+/**
+ * file: thread_pool.cc
+ * 
+ * authors:	Cem Keske
+ * 			Emre Yazici
+ */
+#include "thread_pool.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+
+typedef std::chrono::steady_clock Clock;
+typedef std::chrono::duration<double> Seconds;
+
+/// ===== THREAD POOL ===== ///
+
+
+// ===== Constructor / Destructor =====
+
+Thread_Pool::Thread_Pool(size_t nb_threads) : loop_time_(0), task_(nullptr), 
+											  grain_(1), generation_(0), 
+											  nb_busy_(0), stop_(false) {
+	if(nb_threads == 0)
+		nb_threads = std::max(1u, std::thread::hardware_concurrency());
+	
+	ranges_.reset(new Task_Range[nb_threads]);
+	statistics_.resize(nb_threads);
+	
+	// the thread calling parallel_for works too, with index 0
+	for(size_t i(1); i < nb_threads; ++i)
+		workers_.emplace_back(&Thread_Pool::work, this, i);
+}
+
+Thread_Pool::~Thread_Pool() {
+	{
+	std::lock_guard<std::mutex> lock(mutex_);
+	stop_ = true;
+	}
+	start_.notify_all();
+	for(auto& worker : workers_)
+		worker.join();
+}
+
+// ===== Accessors =====
+
+size_t Thread_Pool::nb_threads() const {return workers_.size() + 1;}
+
+const std::vector<Thread_Pool::Statistics>& Thread_Pool::statistics() const {
+	return statistics_;
+}
+
+double Thread_Pool::loop_time() const {return loop_time_;}
+
+// ===== Methods =====
+
+void Thread_Pool::reset_statistics() {
+	std::lock_guard<std::mutex> loop_lock(loop_mutex_);
+	std::fill(statistics_.begin(), statistics_.end(), Statistics());
+	loop_time_ = 0;
+}
+
+void Thread_Pool::print_statistics(std::ostream& out) const {
+	for(size_t t(0); t < statistics_.size(); ++t) {
+		out << "thread " << t << ": " << statistics_[t].nb_tasks << " tasks, " 
+			<< statistics_[t].nb_steals << " steals, utilisation " << std::fixed 
+			<< std::setprecision(1) 
+			<< (loop_time_ > 0 ? 100 * statistics_[t].busy_time / loop_time_ : 0.)
+			<< "%" << std::defaultfloat << std::endl;
+	}
+}
+
+// ===== Private methods =====
+
+/**
+ * Multi-threaded part of parallel_for.
+ */
+void Thread_Pool::run_loop(size_t nb_tasks, 
+						   const std::function<void(size_t)>& task, size_t grain) {
+	std::unique_lock<std::mutex> loop_lock(loop_mutex_, std::try_to_lock);
+	if(loop_lock.owns_lock() == false) {
+		for(size_t i(0); i < nb_tasks; ++i)
+			task(i);
+		return;
+	}
+	
+	auto start(Clock::now());
+	size_t nb_threads(this->nb_threads());
+	{
+	std::lock_guard<std::mutex> lock(mutex_);
+	for(size_t t(0); t < nb_threads; ++t) {
+		std::lock_guard<std::mutex> range_lock(ranges_[t].mutex);
+		ranges_[t].begin = nb_tasks * t / nb_threads;
+		ranges_[t].end = nb_tasks * (t + 1) / nb_threads;
+	}
+	task_ = &task;
+	grain_ = std::max<size_t>(grain, 1);
+	nb_busy_ = workers_.size();
+	++generation_;
+	}
+	start_.notify_all();
+	
+	run_tasks(0);
+	
+	std::unique_lock<std::mutex> lock(mutex_);
+	done_.wait(lock, [this] {return nb_busy_ == 0;});
+	task_ = nullptr;
+	loop_time_ += Seconds(Clock::now() - start).count();
+}
+
+void Thread_Pool::work(size_t thread_index) {
+	size_t last_generation(0);
+	
+	while(true) {
+		{
+		std::unique_lock<std::mutex> lock(mutex_);
+		start_.wait(lock, [&] {return stop_ || generation_ != last_generation;});
+		if(stop_) return;
+		last_generation = generation_;
+		}
+		
+		run_tasks(thread_index);
+		
+		std::lock_guard<std::mutex> lock(mutex_);
+		if(--nb_busy_ == 0)
+			done_.notify_one();
+	}
+}
+
+/**
+ * Runs the tasks of the own range, then stolen ones, until all ranges are empty.
+ */
+void Thread_Pool::run_tasks(size_t thread_index) {
+	Statistics& statistics(statistics_[thread_index]);
+	size_t begin(0), end(0);
+	
+	do {
+		while(take_tasks(thread_index, begin, end)) {
+			auto start(Clock::now());
+			for(size_t i(begin); i < end; ++i)
+				(*task_)(i);
+			statistics.busy_time += Seconds(Clock::now() - start).count();
+			statistics.nb_tasks += end - begin;
+		}
+	} while(steal_tasks(thread_index));
+}
+
+/**
+ * Takes at most grain_ tasks from the front of the own range.
+ */
+bool Thread_Pool::take_tasks(size_t thread_index, size_t& begin, size_t& end) {
+	Task_Range& range(ranges_[thread_index]);
+	std::lock_guard<std::mutex> lock(range.mutex);
+	if(range.begin == range.end) return false;
+	
+	begin = range.begin;
+	end = std::min(range.begin + grain_, range.end);
+	range.begin = end;
+	return true;
+}
+
+/**
+ * Moves the back half of the first non empty range of another thread to the own 
+ * range. Returns false when all ranges are empty: the loop is finished for this 
+ * thread (tasks taken by others may still be running).
+ */
+bool Thread_Pool::steal_tasks(size_t thread_index) {
+	size_t nb_threads(this->nb_threads());
+	
+	for(size_t k(1); k < nb_threads; ++k) {
+		Task_Range& victim(ranges_[(thread_index + k) % nb_threads]);
+		size_t begin(0), end(0);
+		{
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		if(victim.begin == victim.end) continue;
+		
+		begin = victim.begin + (victim.end - victim.begin) / 2;
+		end = victim.end;
+		victim.end = begin;
+		}
+		
+		Task_Range& own(ranges_[thread_index]);
+		std::lock_guard<std::mutex> lock(own.mutex);
+		own.begin = begin;
+		own.end = end;
+		++statistics_[thread_index].nb_steals;
+		return true;
+	}
+	return false;
+}
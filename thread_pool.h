@@ -0,0 +1,120 @@
+/**
+ * file: thread_pool.h
+ * 
+ * authors:	Cem Keske
+ * 			Emre Yazici
+ */
+#ifndef THREAD_POOL_H_INCLUDED
+#define THREAD_POOL_H_INCLUDED
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <iosfwd>
+#include <cstddef>
+
+/// THREAD POOL ///
+/**
+ * Fixed set of worker threads running fork-join loops with work stealing. 
+ * 
+ * parallel_for gives each thread (the workers and the calling thread) an equal range
+ * of task indexes. A thread runs its own range from the front, "grain" tasks at a 
+ * time. When it is empty, it steals the back half of the range of another thread. 
+ * Uneven tasks (e.g. players looking for a path around obstacles next to players 
+ * seeing their target) are thus spread over all threads.
+ * 
+ * Only one loop runs at a time: a parallel_for called while another one is running 
+ * (from a task, or from another thread) runs its tasks on the calling thread. 
+ * Tasks must not throw.
+ */
+class Thread_Pool {
+	
+	public:
+		
+		/// per thread, since the last reset_statistics()
+		struct Statistics {
+			size_t nb_tasks = 0;
+			size_t nb_steals = 0;
+			double busy_time = 0;	//seconds spent running tasks
+		};
+	
+	private:
+		
+		/// remaining task indexes of one thread, [begin, end)
+		struct Task_Range {
+			std::mutex mutex;
+			size_t begin = 0;
+			size_t end = 0;
+		};
+		
+		std::vector<std::thread> workers_;
+		std::unique_ptr<Task_Range[]> ranges_;		//one per thread, 0 is the caller
+		std::vector<Statistics> statistics_;
+		double loop_time_;							//seconds spent in parallel loops
+		
+		std::mutex loop_mutex_;		//held by the thread running a loop
+		std::mutex mutex_;
+		std::condition_variable start_;
+		std::condition_variable done_;
+		
+		const std::function<void(size_t)>* task_;
+		size_t grain_;
+		
+		size_t generation_;		//incremented for each parallel_for
+		size_t nb_busy_;		//workers still running the current loop
+		bool stop_;
+	
+	public:
+		
+		// ===== Constructor / Destructor =====
+		
+		/// 0 threads: one per hardware thread. The calling thread counts as one.
+		explicit Thread_Pool(size_t nb_threads = 0);
+		~Thread_Pool();
+		
+		Thread_Pool(const Thread_Pool&) = delete;
+		Thread_Pool& operator=(const Thread_Pool&) = delete;
+		
+		// ===== Accessors =====
+		
+		size_t nb_threads() const;
+		const std::vector<Statistics>& statistics() const;
+		double loop_time() const;
+		
+		// ===== Methods =====
+		
+		/**
+		 * Calls task(i) for every i in [0, nb_tasks), in any order and any thread. 
+		 * Threads take "grain" tasks at a time from their range. The task is only 
+		 * wrapped in a std::function (which may allocate) when it is shared with 
+		 * the workers, a loop run on the calling thread calls it directly.
+		 */
+		template <typename Task>
+		void parallel_for(size_t nb_tasks, const Task& task, size_t grain = 1) {
+			if(workers_.empty() || nb_tasks <= 1) {
+				for(size_t i(0); i < nb_tasks; ++i)
+					task(i);
+				return;
+			}
+			run_loop(nb_tasks, task, grain);
+		}
+		
+		void reset_statistics();
+		
+		/// one line per thread: tasks, steals and busy time / loop time
+		void print_statistics(std::ostream&) const;
+		
+	private:
+		
+		void run_loop(size_t nb_tasks, const std::function<void(size_t)>& task,
+					  size_t grain);
+		void work(size_t thread_index);
+		void run_tasks(size_t thread_index);
+		bool take_tasks(size_t thread_index, size_t& begin, size_t& end);
+		bool steal_tasks(size_t thread_index);
+};
+
+#endif
@@ -0,0 +1,132 @@
+/**
+ * file: tiles.cc
+ * 
+ * authors:	Cem Keske
+ * 			Emre Yazici
+ */
+#include "tiles.h"
+#include <algorithm>
+
+/// ===== TILE GRID ===== ///
+
+
+// ===== Constructor =====
+
+Tile_Grid::Tile_Grid() : nb_cells_(0), cells_per_tile_(1), halo_cells_(0), 
+						 tiles_per_side_(0), nb_migrations_(0) {}
+
+// ===== Accessors =====
+
+size_t Tile_Grid::nb_tiles() const {return tiles_.size();}
+
+const Tile_Grid::Tile& Tile_Grid::tile(size_t tile_index) const {
+	return tiles_[tile_index];
+}
+
+size_t Tile_Grid::tile_at(Cell_Index const& cell) const {
+	return (cell.first / cells_per_tile_) * tiles_per_side_ + 
+		   cell.second / cells_per_tile_;
+}
+
+size_t Tile_Grid::tile_of(size_t entity) const {return entity_tiles_[entity];}
+
+size_t Tile_Grid::halo_cells() const {return halo_cells_;}
+
+size_t Tile_Grid::nb_migrations() const {return nb_migrations_;}
+
+// ===== Methods =====
+
+void Tile_Grid::configure(size_t nb_cells, size_t cells_per_tile, size_t halo_cells) {
+	cells_per_tile = std::max<size_t>(cells_per_tile, 1);
+	if(nb_cells == nb_cells_ && cells_per_tile == cells_per_tile_ && 
+	   halo_cells == halo_cells_)
+		return;
+	
+	nb_cells_ = nb_cells;
+	cells_per_tile_ = cells_per_tile;
+	halo_cells_ = halo_cells;
+	tiles_per_side_ = (nb_cells + cells_per_tile - 1) / cells_per_tile;
+	
+	tiles_.assign(tiles_per_side_ * tiles_per_side_, Tile());
+	entity_tiles_.clear();
+	owned_positions_.clear();
+}
+
+/**
+ * A different number of entities means that entities were added or removed and the
+ * indexes changed: the tiles are rebuilt. Otherwise the entities that changed tile 
+ * migrate. Ghost lists are rebuilt in both cases.
+ */
+void Tile_Grid::update(Cell_Index const* cells, size_t nb_entities) {
+	nb_migrations_ = 0;
+	
+	if(nb_entities != entity_tiles_.size()) {
+		rebuild(cells, nb_entities);
+	} else {
+		for(size_t entity(0); entity < nb_entities; ++entity) {
+			size_t to_tile(tile_at(cells[entity]));
+			if(to_tile != entity_tiles_[entity]) {
+				migrate(entity, to_tile);
+				++nb_migrations_;
+			}
+		}
+	}
+	
+	for(auto& tile : tiles_)
+		tile.ghosts.clear();
+	for(size_t entity(0); entity < nb_entities; ++entity)
+		add_ghosts(entity, cells[entity]);
+}
+
+// ===== Private methods =====
+
+void Tile_Grid::rebuild(Cell_Index const* cells, size_t nb_entities) {
+	for(auto& tile : tiles_)
+		tile.owned.clear();
+	
+	entity_tiles_.resize(nb_entities);
+	owned_positions_.resize(nb_entities);
+	for(size_t entity(0); entity < nb_entities; ++entity) {
+		size_t tile(tile_at(cells[entity]));
+		entity_tiles_[entity] = tile;
+		owned_positions_[entity] = tiles_[tile].owned.size();
+		tiles_[tile].owned.push_back(entity);
+	}
+}
+
+/**
+ * Swap-pop from the old owner list, push on the new one.
+ */
+void Tile_Grid::migrate(size_t entity, size_t to_tile) {
+	std::vector<size_t>& from(tiles_[entity_tiles_[entity]].owned);
+	size_t position(owned_positions_[entity]);
+	
+	from[position] = from.back();
+	owned_positions_[from[position]] = position;
+	from.pop_back();
+	
+	entity_tiles_[entity] = to_tile;
+	owned_positions_[entity] = tiles_[to_tile].owned.size();
+	tiles_[to_tile].owned.push_back(entity);
+}
+
+/**
+ * The entity is a ghost of every other tile holding a cell at most halo_cells_ lines
+ * and columns away from its cell.
+ */
+void Tile_Grid::add_ghosts(size_t entity, Cell_Index const& cell) {
+	size_t first_line((cell.first - std::min(cell.first, halo_cells_)) / cells_per_tile_);
+	size_t last_line(std::min(cell.first + halo_cells_, nb_cells_ - 1) / cells_per_tile_);
+	size_t first_col((cell.second - std::min(cell.second, halo_cells_)) /
+					 cells_per_tile_);
+	size_t last_col(std::min(cell.second + halo_cells_, nb_cells_ - 1) / 
+					cells_per_tile_);
+	
+	for(size_t line(first_line); line <= last_line; ++line) {
+		for(size_t col(first_col); col <= last_col; ++col) {
+			size_t tile(line * tiles_per_side_ + col);
+			if(tile != entity_tiles_[entity])
+				tiles_[tile].ghosts.push_back(entity);
+		}
+	}
+}
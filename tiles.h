@@ -0,0 +1,77 @@
+/**
+ * file: tiles.h
+ * 
+ * authors:	Cem Keske
+ * 			Emre Yazici
+ */
+#ifndef TILES_H_INCLUDED
+#define TILES_H_INCLUDED
+
+#include <vector>
+#include <utility>
+#include <cstddef>
+
+/// TILE GRID ///
+/**
+ * Splits the cells of a Map in square tiles of cells_per_tile x cells_per_tile cells.
+ * Every entity (given by the (line, column) of its cell) is owned by the tile holding
+ * its cell, and is a ghost of the other tiles holding a cell at most halo_cells lines
+ * and columns away. A tile thus sees every entity that can interact with the entities
+ * it owns, as long as the interaction range is shorter than halo_cells cells.
+ * 
+ * Between two updates with the same number of entities, only the entities that 
+ * changed tile migrate from an owner list to another.
+ */
+class Tile_Grid {
+	
+	public:
+		
+		typedef std::pair<size_t, size_t> Cell_Index;	//(line, column) in the Map
+		
+		struct Tile {
+			std::vector<size_t> owned;
+			std::vector<size_t> ghosts;		//increasing order
+		};
+	
+	private:
+		size_t nb_cells_;
+		size_t cells_per_tile_;
+		size_t halo_cells_;
+		size_t tiles_per_side_;
+		
+		std::vector<Tile> tiles_;
+		std::vector<size_t> entity_tiles_;		//owner tile of each entity
+		std::vector<size_t> owned_positions_;	//index of each entity in its owner list
+		size_t nb_migrations_;					//during the last update
+	
+	public:
+		
+		// ===== Constructor =====
+		
+		Tile_Grid();
+		
+		// ===== Accessors =====
+		
+		size_t nb_tiles() const;
+		const Tile& tile(size_t tile_index) const;
+		size_t tile_at(Cell_Index const& cell) const;
+		size_t tile_of(size_t entity) const;
+		size_t halo_cells() const;
+		size_t nb_migrations() const;
+		
+		// ===== Methods =====
+		
+		/// drops all entities if the layout changes
+		void configure(size_t nb_cells, size_t cells_per_tile, size_t halo_cells);
+		
+		/// "cells" holds the cell of each entity, indexes must be below nb_cells
+		void update(Cell_Index const* cells, size_t nb_entities);
+		
+	private:
+		
+		void rebuild(Cell_Index const* cells, size_t nb_entities);
+		void migrate(size_t entity, size_t to_tile);
+		void add_ghosts(size_t entity, Cell_Index const& cell);
+};
+
+#endif
@@ -5,9 +5,53 @@
  * 			Emre Yazici
  */
 #include <cmath>
+#include <algorithm>
 #include "tools.h"
 #include "assert.h"
 #include "iostream"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#ifdef __SSE2__
+/**
+ * Lanes of the batch kernels: a register of Scalar, two doubles or four floats in 
+ * the float build. The kernels are written once with these operations.
+ */
+#if defined(SCALAR_FLOAT)
+typedef __m128 Lanes;
+static constexpr size_t nb_lanes(4);
+static inline Lanes load(const Scalar* p) {return _mm_loadu_ps(p);}
+static inline Lanes broadcast(double value) {return _mm_set1_ps(value);}
+static inline Lanes zero() {return _mm_setzero_ps();}
+static inline Lanes add(Lanes a, Lanes b) {return _mm_add_ps(a, b);}
+static inline Lanes sub(Lanes a, Lanes b) {return _mm_sub_ps(a, b);}
+static inline Lanes mul(Lanes a, Lanes b) {return _mm_mul_ps(a, b);}
+static inline Lanes div(Lanes a, Lanes b) {return _mm_div_ps(a, b);}
+static inline Lanes min(Lanes a, Lanes b) {return _mm_min_ps(a, b);}
+static inline Lanes max(Lanes a, Lanes b) {return _mm_max_ps(a, b);}
+static inline Lanes less_equal(Lanes a, Lanes b) {return _mm_cmple_ps(a, b);}
+static inline Lanes both(Lanes a, Lanes b) {return _mm_and_ps(a, b);}
+static inline Lanes either(Lanes a, Lanes b) {return _mm_or_ps(a, b);}
+static inline Mask_Word lane_bits(Lanes a) {return _mm_movemask_ps(a);}
+#else
+typedef __m128d Lanes;
+static constexpr size_t nb_lanes(2);
+static inline Lanes load(const Scalar* p) {return _mm_loadu_pd(p);}
+static inline Lanes broadcast(double value) {return _mm_set1_pd(value);}
+static inline Lanes zero() {return _mm_setzero_pd();}
+static inline Lanes add(Lanes a, Lanes b) {return _mm_add_pd(a, b);}
+static inline Lanes sub(Lanes a, Lanes b) {return _mm_sub_pd(a, b);}
+static inline Lanes mul(Lanes a, Lanes b) {return _mm_mul_pd(a, b);}
+static inline Lanes div(Lanes a, Lanes b) {return _mm_div_pd(a, b);}
+static inline Lanes min(Lanes a, Lanes b) {return _mm_min_pd(a, b);}
+static inline Lanes max(Lanes a, Lanes b) {return _mm_max_pd(a, b);}
+static inline Lanes less_equal(Lanes a, Lanes b) {return _mm_cmple_pd(a, b);}
+static inline Lanes both(Lanes a, Lanes b) {return _mm_and_pd(a, b);}
+static inline Lanes either(Lanes a, Lanes b) {return _mm_or_pd(a, b);}
+static inline Mask_Word lane_bits(Lanes a) {return _mm_movemask_pd(a);}
+#endif
+#endif
 
 /// ===== LOCAL (MODULE) FUNCTION FORWARD DECLARATIONS ===== ///
 
@@ -16,6 +60,24 @@
  */ 
 static double bound(double to_bound, double min, double max);
 
+/**
+ * Single element versions of the batch kernels, used for odd tails (and for all
+ * elements when SSE2 is not available). Same formulas as the pair versions.
+ */
+static bool rectangle_contains_lane(double x_left, double y_down, double x_right, 
+									double y_up, Coordinate const& coord, 
+									Length tol_squared);
+static void set_mask_bits(Mask_Word* mask, size_t index, Mask_Word bits);
+
+/**
+ * Fraction of the move at which "start" enters the box, above 1 if it doesn't.
+ */
+static double box_time_of_impact(double start_x, double start_y, double move_x, 
+								 double move_y, double x_left, double y_down, 
+								 double x_right, double y_up);
+
+static constexpr double no_impact(2.);	//any time_of_impact above 1
+
 
 /// ===== COORDINATE ===== ///
 
@@ -91,7 +153,11 @@ Coordinate const& Vector::pointed() const {
 }
 
 Length Vector::length() const {
-	return std::sqrt(pointed_.x*pointed_.x + pointed_.y*pointed_.y);
+	return std::sqrt(length_squared());
+}
+
+Length Vector::length_squared() const {
+	return pointed_.x*pointed_.x + pointed_.y*pointed_.y;
 }
 
 Angle Vector::angle() const{
@@ -99,7 +165,11 @@ Angle Vector::angle() const{
 }
 
 void Vector::make_unit(){
-	length(1.0);
+	*this = get_unit();
+}
+
+void Vector::rotate(Vector const& rotation){
+	*this = get_rotated(rotation);
 }
 
 void Vector::length(Length length){
@@ -111,15 +181,27 @@ void Vector::length(Length length){
 
 
 Vector Vector::get_perpendicular() const {
-	return Vector(angle() + M_PI_2);
+	Vector unit(get_unit());
+	return Vector(-unit.pointed_.y, unit.pointed_.x);	// (x,y) -> (-y,x)
 }
 
 Vector Vector::get_unit() const {
 	
-	if(pointed_.x == 0 && pointed_.y == 0)
+	Length length2(length_squared());
+	if(length2 == 0)
 		return Vector(0,0);
 	
-	return Vector(angle());
+	Length inverse_length(1.0 / std::sqrt(length2));
+	return Vector(pointed_.x * inverse_length, pointed_.y * inverse_length);
+}
+
+/**
+ * (x + iy) * (c + is) = (xc - ys) + i(xs + yc)
+ */
+Vector Vector::get_rotated(Vector const& rotation) const {
+	Length cos_r(rotation.pointed_.x), sin_r(rotation.pointed_.y);
+	return Vector(pointed_.x * cos_r - pointed_.y * sin_r,
+				  pointed_.x * sin_r + pointed_.y * cos_r);
 }
 
 std::string Vector::to_string() const {
@@ -326,12 +408,77 @@ void Circle::radius(Length radius) {
 
 
 
+/// ===== CIRCLE ARRAYS ===== ///
+
+// ===== Accessors =====
+
+size_t Circle_Arrays::size() const {return x_.size();}
+
+Circle_Span Circle_Arrays::span(size_t first) const {
+	assert(first <= size());
+	return {x_.data() + first, y_.data() + first, radius_.data() + first, 
+			size() - first};
+}
+
+// ===== Manipulators =====
+
+void Circle_Arrays::clear() {
+	x_.clear();
+	y_.clear();
+	radius_.clear();
+}
+
+void Circle_Arrays::reserve(size_t capacity) {
+	x_.reserve(capacity);
+	y_.reserve(capacity);
+	radius_.reserve(capacity);
+}
+
+void Circle_Arrays::push_back(Circle const& circle) {
+	x_.push_back(circle.center().x);
+	y_.push_back(circle.center().y);
+	radius_.push_back(circle.radius());
+}
+
+void Circle_Arrays::center(size_t index, Coordinate const& center) {
+	x_[index] = center.x;
+	y_[index] = center.y;
+}
+
+
+/// ===== RECTANGLE ARRAYS ===== ///
+
+// ===== Accessors =====
+
+size_t Rectangle_Arrays::size() const {return x_left_.size();}
+
+Rectangle_Span Rectangle_Arrays::span() const {
+	return {x_left_.data(), y_down_.data(), x_right_.data(), y_up_.data(), size()};
+}
+
+// ===== Manipulators =====
+
+void Rectangle_Arrays::clear() {
+	x_left_.clear();
+	y_down_.clear();
+	x_right_.clear();
+	y_up_.clear();
+}
+
+void Rectangle_Arrays::push_back(Rectangle const& rectangle) {
+	x_left_.push_back(rectangle.x_left());
+	y_down_.push_back(rectangle.y_down());
+	x_right_.push_back(rectangle.x_right());
+	y_up_.push_back(rectangle.y_up());
+}
+
+
+
 /// ===== Tools namespace ===== ///
 
 bool Tools::intersect(Circle const& circ_one,Circle const& circ_two,Length tolerance){
-	if (tolerance < 0) tolerance = (-tolerance); // sign of tolerance doesn't matter
-	Length sum_of_r = circ_one.radius() + circ_two.radius();
-	return (circ_one.center()).distance(circ_two.center()) <= sum_of_r + tolerance;
+	return overlap(circ_one.center(), circ_two.center(), 
+				   contact_squared(circ_one.radius(), circ_two.radius(), tolerance));
 }
 
 /**
@@ -418,6 +565,389 @@ bool Tools::is_between(double a, double b, double c){
 	return low <= c && c <= high;
 }
 
+// ===== Batch kernels =====
+
+size_t Tools::mask_words(size_t nb_elements) {
+	return (nb_elements + 63) / 64;
+}
+
+bool Tools::mask_test(const Mask_Word* mask, size_t index) {
+	return (mask[index / 64] >> (index % 64)) & 1;
+}
+
+bool Tools::mask_any(const Mask_Word* mask, size_t nb_elements) {
+	Mask_Word all(0);
+	size_t nb_words(mask_words(nb_elements));
+	for(size_t i(0); i < nb_words; ++i)
+		all |= mask[i];
+	return all != 0;
+}
+
+void Tools::mask_set(Mask_Word* mask, size_t index) {
+	mask[index / 64] |= Mask_Word(1) << (index % 64);
+}
+
+void Tools::mask_reset(Mask_Word* mask, size_t index) {
+	mask[index / 64] &= ~(Mask_Word(1) << (index % 64));
+}
+
+size_t Tools::mask_next(const Mask_Word* mask, size_t nb_elements, size_t from) {
+	size_t word(from / 64);
+	size_t nb_words(mask_words(nb_elements));
+	if(word >= nb_words) return nb_elements;
+	
+	Mask_Word bits(mask[word] & (~Mask_Word(0) << (from % 64)));	//drop bits < from
+	while(bits == 0) {
+		if(++word == nb_words) return nb_elements;
+		bits = mask[word];
+	}
+	return std::min(nb_elements, word * 64 + __builtin_ctzll(bits));
+}
+
+/**
+ * Same test as intersect(Circle, Circle, tolerance) for every circle of the span.
+ * The contact distance depends on each radius so it is squared per element.
+ */
+void Tools::intersect(Circle const& circle, Circle_Span const& circles, 
+					  Length tolerance, Mask_Word* mask) {
+	tolerance = policy_tolerance(tolerance);	// once per call, not per element
+	std::fill(mask, mask + mask_words(circles.size), 0);
+	size_t i(0);
+	
+	#ifdef __SSE2__
+	const Lanes center_x(broadcast(circle.center().x));
+	const Lanes center_y(broadcast(circle.center().y));
+	const Lanes radius(broadcast(circle.radius()));
+	const Lanes tol(broadcast(tolerance));
+	
+	for(; i + nb_lanes <= circles.size; i += nb_lanes) {
+		Lanes delta_x(sub(center_x, load(circles.x + i)));
+		Lanes delta_y(sub(center_y, load(circles.y + i)));
+		Lanes dist2(add(mul(delta_x, delta_x), mul(delta_y, delta_y)));
+		Lanes contact(add(add(radius, load(circles.radius + i)), tol));
+		contact = max(contact, zero());	//as contact_squared
+		set_mask_bits(mask, i, lane_bits(less_equal(dist2, mul(contact, contact))));
+	}
+	#endif
+	
+	for(; i < circles.size; ++i) {
+		set_mask_bits(mask, i, overlap(circle.center(), {circles.x[i], circles.y[i]},
+									   contact_squared<Tolerance_Policy::SIGNED>(
+									   circle.radius(), circles.radius[i], tolerance)));
+	}
+}
+
+void Tools::overlap(Coordinate const& center, Circle_Span const& centers, 
+					Length contact_squared, Mask_Word* mask) {
+	std::fill(mask, mask + mask_words(centers.size), 0);
+	size_t i(0);
+	
+	#ifdef __SSE2__
+	const Lanes center_x(broadcast(center.x));
+	const Lanes center_y(broadcast(center.y));
+	const Lanes limit(broadcast(contact_squared));
+	
+	for(; i + nb_lanes <= centers.size; i += nb_lanes) {
+		Lanes delta_x(sub(center_x, load(centers.x + i)));
+		Lanes delta_y(sub(center_y, load(centers.y + i)));
+		Lanes dist2(add(mul(delta_x, delta_x), mul(delta_y, delta_y)));
+		set_mask_bits(mask, i, lane_bits(less_equal(dist2, limit)));
+	}
+	#endif
+	
+	for(; i < centers.size; ++i) {
+		set_mask_bits(mask, i, overlap(center, {centers.x[i], centers.y[i]}, 
+									   contact_squared));
+	}
+}
+
+/**
+ * Same test as intersect(Rectangle, Circle, tolerance) for every rectangle.
+ * A center inside the rectangle has a zero distance to its closest point, so the
+ * "inside" case needs no separate test.
+ */
+void Tools::intersect(Rectangle_Span const& rectangles, Circle const& circle, 
+					  Length tolerance, Mask_Word* mask) {
+	Length tol(tolerance + circle.radius());
+	Length tol_squared(tol*tol);
+	std::fill(mask, mask + mask_words(rectangles.size), 0);
+	size_t i(0);
+	
+	#ifdef __SSE2__
+	const Lanes center_x(broadcast(circle.center().x));
+	const Lanes center_y(broadcast(circle.center().y));
+	const Lanes limit(broadcast(tol_squared));
+	
+	for(; i + nb_lanes <= rectangles.size; i += nb_lanes) {
+		Lanes closest_x(max(min(center_x, load(rectangles.x_right + i)),
+							load(rectangles.x_left + i)));
+		Lanes closest_y(max(min(center_y, load(rectangles.y_up + i)),
+							load(rectangles.y_down + i)));
+		Lanes delta_x(sub(center_x, closest_x));
+		Lanes delta_y(sub(center_y, closest_y));
+		Lanes dist2(add(mul(delta_x, delta_x), mul(delta_y, delta_y)));
+		set_mask_bits(mask, i, lane_bits(less_equal(dist2, limit)));
+	}
+	#endif
+	
+	for(; i < rectangles.size; ++i) {
+		set_mask_bits(mask, i, rectangle_contains_lane(rectangles.x_left[i], 
+													   rectangles.y_down[i],
+													   rectangles.x_right[i], 
+													   rectangles.y_up[i],
+													   circle.center(), tol_squared));
+	}
+}
+
+/**
+ * Same test as intersect(Rectangle, Segment, tolerance) for every rectangle.
+ * 
+ * Everything that depends only on the segment (its direction, the quadrant and thus
+ * which corners are risky, the bounds for can_be_on) is computed once. The branches
+ * of the single version are replaced by OR/AND of the four partial results:
+ * 		a inside || b inside || (risky a inside && on seg) || (risky b inside && on seg)
+ */
+void Tools::intersect(Rectangle_Span const& rectangles, Segment const& seg, 
+					  Length tolerance, Mask_Word* mask) {
+	std::fill(mask, mask + mask_words(rectangles.size), 0);
+	
+	const Coordinate& a(seg.point_a());
+	const Coordinate b(seg.point_b());
+	Length delta_x(a.x - b.x);
+	Length delta_y(a.y - b.y);
+	double norm2_value(delta_x*delta_x + delta_y*delta_y);
+	Length tol_squared(tolerance*tolerance);
+	
+	// the risky corners are top left & bottom right in 1. and 3. quadrants, 
+	// top right & bottom left otherwise (see Tools::intersect above)
+	bool first_quadrant(delta_y * delta_x > 0);
+	const Scalar* risky_a_x(first_quadrant ? rectangles.x_left : rectangles.x_right);
+	const Scalar* risky_b_x(first_quadrant ? rectangles.x_right : rectangles.x_left);
+	
+	double low_x(std::min(a.x, b.x)), high_x(std::max(a.x, b.x));
+	double low_y(std::min(a.y, b.y)), high_y(std::max(a.y, b.y));
+	size_t i(0);
+	
+	#ifdef __SSE2__
+	const Lanes a_x(broadcast(a.x)), a_y(broadcast(a.y));
+	const Lanes b_x(broadcast(b.x)), b_y(broadcast(b.y));
+	const Lanes d_x(broadcast(delta_x)), d_y(broadcast(delta_y));
+	const Lanes norm2(broadcast(norm2_value));
+	const Lanes limit(broadcast(tol_squared));
+	const Lanes lo_x(broadcast(low_x)), hi_x(broadcast(high_x));
+	const Lanes lo_y(broadcast(low_y)), hi_y(broadcast(high_y));
+	
+	for(; i + nb_lanes <= rectangles.size; i += nb_lanes) {
+		const Lanes x_left(load(rectangles.x_left + i));
+		const Lanes x_right(load(rectangles.x_right + i));
+		const Lanes y_down(load(rectangles.y_down + i));
+		const Lanes y_up(load(rectangles.y_up + i));
+		
+		// rectangle.contains(point, tol) for two points in each lane
+		auto contains = [&](Lanes p_x, Lanes p_y) {
+			Lanes c_x(max(min(p_x, x_right), x_left));
+			Lanes c_y(max(min(p_y, y_up), y_down));
+			Lanes dx(sub(p_x, c_x)), dy(sub(p_y, c_y));
+			return less_equal(add(mul(dx, dx), mul(dy, dy)), limit);
+		};
+		// Tools::closest_point(seg, corner)
+		auto closest_x = [&](Lanes k) {return add(a_x, mul(d_x, k));};
+		auto closest_y = [&](Lanes k) {return add(a_y, mul(d_y, k));};
+		auto projection = [&](Lanes c_x, Lanes c_y) {
+			Lanes s_x(sub(c_x, a_x)), s_y(sub(c_y, a_y));
+			return div(add(mul(s_x, d_x), mul(s_y, d_y)), norm2);
+		};
+		// Tools::can_be_on(seg, point)
+		auto on_segment = [&](Lanes p_x, Lanes p_y) {
+			return both(both(less_equal(lo_x, p_x), less_equal(p_x, hi_x)),
+						both(less_equal(lo_y, p_y), less_equal(p_y, hi_y)));
+		};
+		
+		Lanes k_a(projection(load(risky_a_x + i), y_up));
+		Lanes k_b(projection(load(risky_b_x + i), y_down));
+		Lanes risky_ax(closest_x(k_a)), risky_ay(closest_y(k_a));
+		Lanes risky_bx(closest_x(k_b)), risky_by(closest_y(k_b));
+		
+		Lanes result(either(contains(a_x, a_y), contains(b_x, b_y)));
+		result = either(result, both(contains(risky_ax, risky_ay),
+									 on_segment(risky_ax, risky_ay)));
+		result = either(result, both(contains(risky_bx, risky_by),
+									 on_segment(risky_bx, risky_by)));
+		set_mask_bits(mask, i, lane_bits(result));
+	}
+	#endif
+	
+	for(; i < rectangles.size; ++i) {
+		double x_left(rectangles.x_left[i]), x_right(rectangles.x_right[i]);
+		double y_down(rectangles.y_down[i]), y_up(rectangles.y_up[i]);
+		auto contains = [&](Coordinate const& point) {
+			return rectangle_contains_lane(x_left, y_down, x_right, y_up, point, 
+										   tol_squared);
+		};
+		Coordinate risky_a(closest_point(seg, {risky_a_x[i], y_up}));
+		Coordinate risky_b(closest_point(seg, {risky_b_x[i], y_down}));
+		set_mask_bits(mask, i, contains(a) || contains(b) || 
+							   (contains(risky_a) && can_be_on(seg, risky_a)) ||
+							   (contains(risky_b) && can_be_on(seg, risky_b)));
+	}
+}
+
+void Tools::segment_not_connected(Rectangle_Span const& rectangles, 
+								  Coordinate const& a, Coordinate const& b, 
+								  Length tolerance, Mask_Word* mask) {
+	intersect(rectangles, Segment(a.x,a.y,b.x,b.y), tolerance, mask);
+}
+
+
+// ===== Continuous tests =====
+
+double Tools::time_of_impact(Coordinate const& start, Vector const& move, 
+							 Coordinate const& center, Length contact_squared) {
+	double delta_x(start.x - center.x), delta_y(start.y - center.y);
+	double move_x(move.pointed().x), move_y(move.pointed().y);
+	
+	// |delta + t*move|^2 = contact_squared, smallest root
+	double c(delta_x*delta_x + delta_y*delta_y - contact_squared);
+	if(c <= 0) return 0;
+	double a(move_x*move_x + move_y*move_y);
+	double half_b(delta_x*move_x + delta_y*move_y);
+	if(a == 0 || half_b >= 0) return no_impact;		//still or moving away
+	
+	double discriminant(half_b*half_b - a*c);
+	if(discriminant < 0) return no_impact;
+	return (-half_b - std::sqrt(discriminant)) / a;
+}
+
+/**
+ * The rectangle with a tolerance is the union of the rectangle widened by the 
+ * tolerance, the rectangle heightened by the tolerance and the disks of radius 
+ * "tolerance" at its corners: the first contact is the first contact with one of them.
+ */
+double Tools::time_of_impact(Coordinate const& start, Vector const& move, 
+							 Rectangle const& rectangle, Length tolerance) {
+	double move_x(move.pointed().x), move_y(move.pointed().y);
+	double x_left(rectangle.x_left()), x_right(rectangle.x_right());
+	double y_down(rectangle.y_down()), y_up(rectangle.y_up());
+	
+	double time(std::min(box_time_of_impact(start.x, start.y, move_x, move_y, 
+											x_left - tolerance, y_down, 
+											x_right + tolerance, y_up),
+						 box_time_of_impact(start.x, start.y, move_x, move_y, 
+											x_left, y_down - tolerance, 
+											x_right, y_up + tolerance)));
+	Length tol_squared(tolerance*tolerance);
+	for(double corner_x : {x_left, x_right}) {
+		for(double corner_y : {y_down, y_up}) {
+			time = std::min(time, time_of_impact(start, move, {corner_x, corner_y}, 
+												 tol_squared));
+		}
+	}
+	return time;
+}
+
+/**
+ * Distance from the center to the segment it travels, at the closest point of the 
+ * segment (the projection clamped to the move).
+ */
+void Tools::swept_overlap(Coordinate const& start, Vector const& move, 
+						  Circle_Span const& centers, Length contact_squared, 
+						  Mask_Word* mask) {
+	std::fill(mask, mask + mask_words(centers.size), 0);
+	double move_x(move.pointed().x), move_y(move.pointed().y);
+	double move2(move_x*move_x + move_y*move_y);
+	double inverse_move2(move2 > 0 ? 1 / move2 : 0);
+	size_t i(0);
+	
+	#ifdef __SSE2__
+	const Lanes start_x(broadcast(start.x));
+	const Lanes start_y(broadcast(start.y));
+	const Lanes m_x(broadcast(move_x)), m_y(broadcast(move_y));
+	const Lanes inverse(broadcast(inverse_move2));
+	const Lanes one(broadcast(1.));
+	const Lanes limit(broadcast(contact_squared));
+	
+	for(; i + nb_lanes <= centers.size; i += nb_lanes) {
+		Lanes delta_x(sub(load(centers.x + i), start_x));
+		Lanes delta_y(sub(load(centers.y + i), start_y));
+		Lanes t(mul(add(mul(delta_x, m_x), mul(delta_y, m_y)), inverse));
+		t = min(max(t, zero()), one);
+		Lanes gap_x(sub(delta_x, mul(t, m_x)));
+		Lanes gap_y(sub(delta_y, mul(t, m_y)));
+		Lanes dist2(add(mul(gap_x, gap_x), mul(gap_y, gap_y)));
+		set_mask_bits(mask, i, lane_bits(less_equal(dist2, limit)));
+	}
+	#endif
+	
+	for(; i < centers.size; ++i) {
+		double delta_x(centers.x[i] - start.x), delta_y(centers.y[i] - start.y);
+		double t(bound((delta_x*move_x + delta_y*move_y) * inverse_move2, 0, 1));
+		double gap_x(delta_x - t*move_x), gap_y(delta_y - t*move_y);
+		set_mask_bits(mask, i, gap_x*gap_x + gap_y*gap_y <= contact_squared);
+	}
+}
+
+/**
+ * Only the rectangles meeting the bounding box of the move (with the tolerance) go
+ * through time_of_impact.
+ */
+void Tools::swept_intersect(Rectangle_Span const& rectangles, Coordinate const& start,
+							Vector const& move, Length tolerance, Mask_Word* mask) {
+	std::fill(mask, mask + mask_words(rectangles.size), 0);
+	Coordinate end(start + move.pointed());
+	double lo_x(std::min<double>(start.x, end.x) - tolerance);
+	double hi_x(std::max<double>(start.x, end.x) + tolerance);
+	double lo_y(std::min<double>(start.y, end.y) - tolerance);
+	double hi_y(std::max<double>(start.y, end.y) + tolerance);
+	
+	for(size_t i(0); i < rectangles.size; ++i) {
+		if(rectangles.x_right[i] < lo_x || hi_x < rectangles.x_left[i] ||
+		   rectangles.y_up[i] < lo_y || hi_y < rectangles.y_down[i]) continue;
+		
+		Rectangle rectangle({rectangles.x_left[i], rectangles.y_down[i]}, 
+							{rectangles.x_right[i], rectangles.y_up[i]});
+		set_mask_bits(mask, i, time_of_impact(start, move, rectangle, tolerance) <= 1);
+	}
+}
+
+
+/// ===== LOCAL (MODULE) FUNCTION DEFINITIONS ===== ///
+
+bool rectangle_contains_lane(double x_left, double y_down, double x_right, 
+							 double y_up, Coordinate const& coord, 
+							 Length tol_squared) {
+	Coordinate closest_point(bound(coord.x, x_left, x_right),
+							 bound(coord.y, y_down, y_up));
+	return Tools::dist_squared(coord, closest_point) <= tol_squared;
+}
+
+/**
+ * "bits" must not cross a word boundary. (lanes always start at a multiple of 
+ * nb_lanes, which divides 64)
+ */
+void set_mask_bits(Mask_Word* mask, size_t index, Mask_Word bits) {
+	mask[index / 64] |= bits << (index % 64);
+}
+
+/**
+ * Slab method: the move enters the box when it is inside both the x and the y bounds.
+ */
+double box_time_of_impact(double start_x, double start_y, double move_x, double move_y,
+						  double x_left, double y_down, double x_right, double y_up) {
+	double enter(0), leave(1);
+	auto clip = [&](double start, double move, double low, double high) {
+		if(move == 0)
+			return low <= start && start <= high;
+		double t_low((low - start) / move), t_high((high - start) / move);
+		if(t_low > t_high) std::swap(t_low, t_high);
+		enter = std::max(enter, t_low);
+		leave = std::min(leave, t_high);
+		return enter <= leave;
+	};
+	if(clip(start_x, move_x, x_left, x_right) && clip(start_y, move_y, y_down, y_up))
+		return enter;
+	return no_impact;
+}
+
 double bound(double to_bound, double min, double max) {
 	to_bound = std::min(max, to_bound);
 	to_bound = std::max(min, to_bound);		
@@ -12,12 +12,30 @@
 /// ===== INCLUDES ===== ///
 
 #include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
 
 /// ===== TYPEDEFS ===== ///
 
+/**
+ * Storage type of the coordinates and sizes of the geometric objects and of the 
+ * arrays of the batch kernels, selected at build time (see Makefile, 
+ * SCALAR=double|float). In the float build the arrays are half as large and the 
+ * batch kernels test four elements at a time in single precision, other 
+ * computations are done in double and rounded when stored.
+ */
+#if defined(SCALAR_FLOAT)
+typedef float Scalar;
+#else
+typedef double Scalar;
+#endif
+
 typedef double Length; 
 typedef double Angle;
 typedef unsigned int Counter; //any type that counts something...
+typedef uint64_t Mask_Word;	//bit i of a mask is the result for element i
 
 /// ===== STRUCTS ===== ///
 
@@ -35,8 +53,8 @@ struct Color {
 
 struct Coordinate {
 
-	double x;
-	double y;
+	Scalar x;
+	Scalar y;
 	
 	// ===== Constructors =====
 	
@@ -105,14 +123,24 @@ class Vector {
 		 * Returns the euclidean length of the vector.
 		 */
 		Length length() const;
+		Length length_squared() const;	//no sqrt, used for fast comparisons
 		
 		/**
 		 * Returns a perpendicular unit vector. 
 		 * (Rotated pi/2 radians in positive direction.)
+		 * 
+		 * This and get_unit() use only multiplications and one inverse square
+		 * root, no trigonometric functions.
 		 */
 		Vector get_perpendicular() const;
 		Vector get_unit() const;
 		
+		/**
+		 * Returns the vector rotated by the angle of "rotation", which must be a 
+		 * unit vector. (i.e. multiplication of complex numbers, no trigonometry)
+		 */
+		Vector get_rotated(Vector const& rotation) const;
+		
 		// ===== Manipulators =====
 		
 		void angle(Angle);
@@ -123,6 +151,7 @@ class Vector {
 		 * Sets the vector's length to "1".
 		 */ 
 		void make_unit();
+		void rotate(Vector const& rotation);	//rotation must be a unit vector
 		
 		// ===== Utilities =====
 		
@@ -196,8 +225,8 @@ class Rectangle {
 	
 	private:
 		Coordinate bottom_left_;
-		Length base_;
-		Length height_;
+		Scalar base_;
+		Scalar height_;
 	
 	public:
 		
@@ -244,7 +273,7 @@ class Rectangle {
 class Circle {
 	protected:
 		Coordinate center_;
-		Length radius_;
+		Scalar radius_;
 	
 	public:
 		
@@ -266,6 +295,75 @@ class Circle {
 };
 
 
+/// ===== STRUCTURES OF ARRAYS FOR BATCH QUERIES ===== ///
+
+/**
+ * Read-only views on many circles/rectangles stored as separate arrays, 
+ * so that they can be tested in one call by the batch kernels in Tools.
+ */
+struct Circle_Span {
+	const Scalar* x;
+	const Scalar* y;
+	const Scalar* radius;
+	size_t size;
+};
+
+struct Rectangle_Span {
+	const Scalar* x_left;
+	const Scalar* y_down;
+	const Scalar* x_right;
+	const Scalar* y_up;
+	size_t size;
+};
+
+/// CIRCLE ARRAYS ///
+/**
+ * Owns the arrays behind a Circle_Span. Capacity is kept between refills.
+ */
+class Circle_Arrays {
+	private:
+		std::vector<Scalar> x_;
+		std::vector<Scalar> y_;
+		std::vector<Scalar> radius_;
+	
+	public:
+		
+		// ===== Accessors =====
+		
+		size_t size() const;
+		Circle_Span span(size_t first = 0) const; //elements from "first" to the end
+		
+		// ===== Manipulators =====
+		
+		void clear();
+		void reserve(size_t);
+		void push_back(Circle const&);
+		void center(size_t index, Coordinate const&);
+};
+
+/// RECTANGLE ARRAYS ///
+
+class Rectangle_Arrays {
+	private:
+		std::vector<Scalar> x_left_;
+		std::vector<Scalar> y_down_;
+		std::vector<Scalar> x_right_;
+		std::vector<Scalar> y_up_;
+	
+	public:
+		
+		// ===== Accessors =====
+		
+		size_t size() const;
+		Rectangle_Span span() const;
+		
+		// ===== Manipulators =====
+		
+		void clear();
+		void push_back(Rectangle const&);
+};
+
+
 /// ===== NAMESPACES FOR UTILITY FUNCTIONS ===== ///
 
 namespace Tools {	
@@ -280,6 +378,45 @@ namespace Tools {
 		constexpr Color COLOR_BLACK 	= {0.0,		0.0,	0.0};
 		constexpr Color COLOR_WHITE 	= {1.0,		1.0,	1.0};
 		
+		/**
+		 * How the tolerance of circle tests is interpreted. With ABSOLUTE the sign
+		 * of the tolerance doesn't matter (historical behaviour), with SIGNED a
+		 * negative tolerance requires the circles to overlap by that much.
+		 */
+		enum class Tolerance_Policy {ABSOLUTE, SIGNED};
+		constexpr Tolerance_Policy CIRCLE_TOLERANCE_POLICY = Tolerance_Policy::ABSOLUTE;
+		
+		/// tolerance as the policy reads it
+		template <Tolerance_Policy policy = CIRCLE_TOLERANCE_POLICY>
+		constexpr Length policy_tolerance(Length tolerance) {
+			return (policy == Tolerance_Policy::ABSOLUTE && tolerance < 0) ? 
+				   -tolerance : tolerance;
+		}
+		
+		constexpr Length square(Length length) {return length * length;}
+		
+		/**
+		 * Returns (r1 + r2 + tol)^2 : two circles with these radii intersect when the
+		 * squared distance between their centers is at most this value. Meant to be
+		 * computed once outside of the loops, then used with overlap(). A negative
+		 * sum (SIGNED overlap larger than the radii) counts as 0, only circles with 
+		 * the same center intersect.
+		 */
+		template <Tolerance_Policy policy = CIRCLE_TOLERANCE_POLICY>
+		constexpr Length contact_squared(Length r1, Length r2, Length tolerance) {
+			return square(std::max<Length>(0, 
+										   r1 + r2 + policy_tolerance<policy>(tolerance)));
+		}
+		
+		/**
+		 * Circle-circle test on squared distances. No sqrt, no branch.
+		 */
+		inline bool overlap(Coordinate const& c1, Coordinate const& c2, 
+							Length contact_squared) {
+			Length delta_x(c1.x - c2.x), delta_y(c1.y - c2.y);
+			return delta_x*delta_x + delta_y*delta_y <= contact_squared;
+		}
+		
 		/**
 		 * WARNING!!
 		 * If a shape's into another shape, we consider the intersection exists.
@@ -312,6 +449,68 @@ namespace Tools {
 		 * Returns true if c is between a and b.
 		 */ 
 		 bool is_between(double a, double b, double c);
+		 
+		/**
+		 * Batch kernels.
+		 * 
+		 * Each one tests a single shape against all elements of a span and writes
+		 * the results to "mask" (which must hold mask_words(span.size) words). They 
+		 * give exactly the same answers as the single pair versions above, but
+		 * work on two elements at a time (SSE2) without branching per element. In
+		 * the float build they work on four elements in single precision, so a 
+		 * result can differ from the pair version by rounding at the contact 
+		 * distance.
+		 */
+		size_t mask_words(size_t nb_elements);
+		bool mask_test(const Mask_Word* mask, size_t index);
+		bool mask_any(const Mask_Word* mask, size_t nb_elements);
+		void mask_set(Mask_Word* mask, size_t index);
+		void mask_reset(Mask_Word* mask, size_t index);
+		
+		/**
+		 * Returns the index of the first set bit at or after "from", or nb_elements
+		 * if there are none. Used to visit only the hits of a mask.
+		 */
+		size_t mask_next(const Mask_Word* mask, size_t nb_elements, size_t from);
+		
+		void intersect(Circle const&, Circle_Span const&, Length tolerance,
+					   Mask_Word* mask);
+		
+		/**
+		 * overlap() for all centers of the span with a common contact_squared
+		 * (the radii of the span are not read).
+		 */
+		void overlap(Coordinate const& center, Circle_Span const& centers, 
+					 Length contact_squared, Mask_Word* mask);
+		void intersect(Rectangle_Span const&, Circle const&, Length tolerance,
+					   Mask_Word* mask);
+		void intersect(Rectangle_Span const&, Segment const&, Length tolerance,
+					   Mask_Word* mask);
+		void segment_not_connected(Rectangle_Span const&, Coordinate const& a,
+								   Coordinate const& b, Length tolerance,
+								   Mask_Word* mask);
+		
+		/**
+		 * Continuous tests, for a center moving in a straight line from "start" by
+		 * "move" during a step. time_of_impact returns the fraction of the move (0 
+		 * to 1) at the first contact, or a value above 1 if there is none. Contact
+		 * means the same as in overlap() and in Rectangle::contains(coord, tol).
+		 * (to test two moving centers, use the move of one relative to the other)
+		 */
+		double time_of_impact(Coordinate const& start, Vector const& move, 
+							  Coordinate const& center, Length contact_squared);
+		double time_of_impact(Coordinate const& start, Vector const& move, 
+							  Rectangle const&, Length tolerance);
+		
+		/**
+		 * Masks of the elements whose time_of_impact is at most 1 (the centers of 
+		 * the span don't move).
+		 */
+		void swept_overlap(Coordinate const& start, Vector const& move, 
+						   Circle_Span const& centers, Length contact_squared, 
+						   Mask_Word* mask);
+		void swept_intersect(Rectangle_Span const&, Coordinate const& start, 
+							 Vector const& move, Length tolerance, Mask_Word* mask);
 };
 
 
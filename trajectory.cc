@@ -0,0 +1,401 @@
+/**
+ * file: trajectory.cc
+ * 
+ * authors:	Cem Keske
+ * 			Emre Yazici
+ */
+#include "trajectory.h"
+#include "define.h"
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+static constexpr size_t max_pending(64);		//frames waiting for the I/O thread
+static constexpr size_t batch_size(1 << 16);	//bytes written at once
+static constexpr size_t max_varint_bytes(10);
+static const std::string trajectory_extension(".traj");
+static constexpr size_t no_frame(SIZE_MAX);		//nothing decoded yet
+
+// ===== Encoding =====
+
+static void put_varint(std::vector<unsigned char>& out, uint64_t value) {
+	while(value >= 0x80) {
+		out.push_back(static_cast<unsigned char>(value | 0x80));
+		value >>= 7;
+	}
+	out.push_back(static_cast<unsigned char>(value));
+}
+
+/// zigzag: small negative values stay short
+static void put_signed(std::vector<unsigned char>& out, int64_t value) {
+	put_varint(out, (static_cast<uint64_t>(value) << 1) ^
+					static_cast<uint64_t>(value >> 63));
+}
+
+static bool get_varint(const unsigned char*& position, const unsigned char* end,
+					   uint64_t& value) {
+	value = 0;
+	for(size_t i(0); i < max_varint_bytes && position != end; ++i) {
+		unsigned char byte(*position++);
+		value |= static_cast<uint64_t>(byte & 0x7f) << (7 * i);
+		if((byte & 0x80) == 0) return true;
+	}
+	return false;
+}
+
+static bool get_signed(const unsigned char*& position, const unsigned char* end,
+					   int64_t& value) {
+	uint64_t zigzag(0);
+	if(get_varint(position, end, zigzag) == false) return false;
+	value = static_cast<int64_t>(zigzag >> 1) ^ -static_cast<int64_t>(zigzag & 1);
+	return true;
+}
+
+static void quantise(Saved_State const& state, Trajectory::Quantised_Frame& frame) {
+	frame.players.resize(state.players.size());
+	for(size_t i(0); i < state.players.size(); ++i) {
+		Snapshot::Player_Record const& player(state.players[i]);
+		frame.players[i] = {std::llround(player.x / Trajectory::position_quantum),
+							std::llround(player.y / Trajectory::position_quantum),
+							player.lives, player.cooldown};
+	}
+	frame.balls.resize(state.balls.size());
+	for(size_t i(0); i < state.balls.size(); ++i) {
+		Snapshot::Ball_Record const& ball(state.balls[i]);
+		frame.balls[i] = {std::llround(ball.x / Trajectory::position_quantum),
+						  std::llround(ball.y / Trajectory::position_quantum),
+						  std::llround(ball.angle / Trajectory::angle_quantum)};
+	}
+	frame.obstacles = state.obstacles;
+}
+
+/// value of each element, or difference with "reference" (same size)
+template <size_t N>
+static void put_values(std::vector<unsigned char>& out,
+					   std::vector<std::array<int64_t, N>> const& values,
+					   std::vector<std::array<int64_t, N>> const& reference,
+					   bool deltas) {
+	for(size_t i(0); i < values.size(); ++i) {
+		for(size_t k(0); k < N; ++k)
+			put_signed(out, deltas ? values[i][k] - reference[i][k] : values[i][k]);
+	}
+}
+
+/**
+ * Decodes in place: "values" holds the reference of the deltas. Each value takes at
+ * least a byte, a count the rest of the frame can't hold is refused before anything 
+ * is allocated for it.
+ */
+template <size_t N>
+static bool get_values(const unsigned char*& position, const unsigned char* end,
+					   std::vector<std::array<int64_t, N>>& values, uint64_t count,
+					   bool deltas) {
+	if(count > uint64_t(end - position) / N)
+		return false;
+	if(deltas == false)
+		values.assign(count, std::array<int64_t, N>());
+	else if(values.size() != count)
+		return false;
+
+	int64_t value(0);
+	for(auto& element : values) {
+		for(size_t k(0); k < N; ++k) {
+			if(get_signed(position, end, value) == false) return false;
+			element[k] = deltas ? element[k] + value : value;
+		}
+	}
+	return true;
+}
+
+bool Trajectory::is_trajectory_path(const std::string& file_path) {
+	return file_path.size() >= trajectory_extension.size() &&
+		   file_path.compare(file_path.size() - trajectory_extension.size(),
+							 trajectory_extension.size(), trajectory_extension) == 0;
+}
+
+
+/// ===== TRAJECTORY RECORDER ===== ///
+
+// ===== Constructor / Destructor =====
+
+Trajectory_Recorder::Trajectory_Recorder(const std::string& file_path,
+										 size_t nb_cells) :
+	file_(file_path, std::ios::out | std::ios::binary), nb_cells_(nb_cells),
+	current_(nullptr), stop_(false), nb_frames_(0), failed_(false) {
+
+	if(file_.is_open() == false) return;
+
+	Trajectory::Header header;
+	std::memcpy(header.magic, Trajectory::magic, sizeof(header.magic));
+	header.version = Trajectory::version;
+	header.byte_order = Snapshot::byte_order_mark;
+	header.nb_cells = nb_cells_;
+	header.keyframe_interval = Trajectory::keyframe_interval;
+	header.position_quantum = Trajectory::position_quantum;
+	header.angle_quantum = Trajectory::angle_quantum;
+	file_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+	batch_.reserve(batch_size + batch_size / 2);
+	io_thread_ = std::thread(&Trajectory_Recorder::run_io_thread, this);
+}
+
+Trajectory_Recorder::~Trajectory_Recorder() {
+	close();
+}
+
+// ===== Methods =====
+
+bool Trajectory_Recorder::is_open() const {return file_.is_open();}
+
+size_t Trajectory_Recorder::nb_frames() const {return nb_frames_;}
+
+/**
+ * Takes a free frame, or makes a new one while there are less than max_pending.
+ * Otherwise waits for the I/O thread to free one.
+ */
+Saved_State& Trajectory_Recorder::next_frame() {
+	std::unique_lock<std::mutex> lock(mutex_);
+	if(free_frames_.empty() && frames_.size() < max_pending) {
+		frames_.emplace_back(new Frame);
+		free_frames_.push_back(frames_.back().get());
+	}
+	frame_freed_.wait(lock, [this] {return free_frames_.empty() == false;});
+
+	current_ = free_frames_.back();
+	free_frames_.pop_back();
+	return current_->state;
+}
+
+void Trajectory_Recorder::commit(size_t step) {
+	current_->step = step;
+	{
+	std::lock_guard<std::mutex> lock(mutex_);
+	full_frames_.push_back(current_);
+	}
+	current_ = nullptr;
+	frame_committed_.notify_one();
+}
+
+bool Trajectory_Recorder::close() {
+	if(io_thread_.joinable()) {
+		{
+		std::lock_guard<std::mutex> lock(mutex_);
+		stop_ = true;
+		}
+		frame_committed_.notify_one();
+		io_thread_.join();
+	}
+	if(file_.is_open()) {
+		file_.close();
+		failed_ = failed_ || file_.fail();
+	}
+	return failed_ == false;
+}
+
+/**
+ * Takes all the committed frames at once, so that the lock is only held to exchange
+ * the queues.
+ */
+void Trajectory_Recorder::run_io_thread() {
+	std::deque<Frame*> frames;
+	std::unique_lock<std::mutex> lock(mutex_);
+	while(true) {
+		frame_committed_.wait(lock, [this] {
+			return stop_ || full_frames_.empty() == false;
+		});
+		if(full_frames_.empty()) break;		//stopped, everything is encoded
+		frames.swap(full_frames_);
+		lock.unlock();
+
+		for(Frame* frame : frames)
+			encode(*frame);
+
+		lock.lock();
+		free_frames_.insert(free_frames_.end(), frames.begin(), frames.end());
+		frames.clear();
+		frame_freed_.notify_one();
+	}
+	lock.unlock();
+	flush_batch();
+}
+
+void Trajectory_Recorder::encode(Frame const& frame) {
+	Trajectory::Quantised_Frame& current(quantised_);
+	quantise(frame.state, current);
+
+	bool keyframe(nb_frames_ % Trajectory::keyframe_interval == 0);
+	bool player_deltas(!keyframe && current.players.size() == previous_.players.size());
+	bool ball_deltas(!keyframe && current.balls.size() == previous_.balls.size());
+	bool has_obstacles(keyframe || current.obstacles != previous_.obstacles);
+	uint8_t flags((keyframe ? Trajectory::KEYFRAME : 0) |
+				  (player_deltas ? Trajectory::PLAYER_DELTAS : 0) |
+				  (ball_deltas ? Trajectory::BALL_DELTAS : 0) |
+				  (has_obstacles ? Trajectory::HAS_OBSTACLES : 0));
+
+	size_t frame_start(batch_.size());
+	batch_.resize(frame_start + sizeof(uint32_t));	//size, known at the end
+	batch_.push_back(flags);
+	put_varint(batch_, frame.step);
+	put_varint(batch_, current.players.size());
+	put_varint(batch_, current.balls.size());
+	put_values(batch_, current.players, previous_.players, player_deltas);
+	put_values(batch_, current.balls, previous_.balls, ball_deltas);
+	if(has_obstacles) {
+		const unsigned char* bitmap(reinterpret_cast<const unsigned char*>(
+										current.obstacles.data()));
+		batch_.insert(batch_.end(), bitmap,
+					  bitmap + current.obstacles.size() * sizeof(Mask_Word));
+	}
+	uint32_t frame_size(batch_.size() - frame_start - sizeof(uint32_t));
+	std::memcpy(batch_.data() + frame_start, &frame_size, sizeof(frame_size));
+
+	std::swap(previous_, quantised_);
+	++nb_frames_;
+	if(batch_.size() >= batch_size)
+		flush_batch();
+}
+
+void Trajectory_Recorder::flush_batch() {
+	file_.write(reinterpret_cast<const char*>(batch_.data()), batch_.size());
+	failed_ = failed_ || file_.fail();
+	batch_.clear();
+}
+
+
+/// ===== TRAJECTORY REPLAY ===== ///
+
+// ===== Constructor =====
+
+Trajectory_Replay::Trajectory_Replay(const std::string& file_path) :
+	file_(file_path), valid_(false), decoded_index_(no_frame) {
+
+	if(file_.size() < sizeof(header_)) return;
+	std::memcpy(&header_, file_.data(), sizeof(header_));
+
+	valid_ = std::memcmp(header_.magic, Trajectory::magic, sizeof(header_.magic)) == 0
+			 && header_.version == Trajectory::version
+			 && header_.byte_order == Snapshot::byte_order_mark
+			 && header_.nb_cells >= MIN_CELL && header_.nb_cells <= MAX_CELL
+			 && index_frames();
+}
+
+// ===== Methods =====
+
+bool Trajectory_Replay::is_valid() const {return valid_;}
+
+size_t Trajectory_Replay::nb_cells() const {return header_.nb_cells;}
+
+size_t Trajectory_Replay::nb_frames() const {return frames_.size();}
+
+size_t Trajectory_Replay::first_step() const {return frames_.front().step;}
+
+size_t Trajectory_Replay::last_step() const {return frames_.back().step;}
+
+size_t Trajectory_Replay::frame_step(size_t index) const {return frames_[index].step;}
+
+size_t Trajectory_Replay::frame_index(size_t step) const {
+	auto after(std::upper_bound(frames_.begin(), frames_.end(), step,
+								[](size_t step, Frame_Entry const& frame) {
+		return step < frame.step;
+	}));
+	return after == frames_.begin() ? 0 : after - frames_.begin() - 1;
+}
+
+bool Trajectory_Replay::seek(size_t step, Saved_State& state) {
+	return frame(frame_index(step), state);
+}
+
+bool Trajectory_Replay::frame(size_t index, Saved_State& state) {
+	if(valid_ == false || index >= frames_.size() || decode(index) == false)
+		return false;
+
+	state.nb_cells = header_.nb_cells;
+	state.players.clear();
+	for(auto const& player : decoded_.players) {
+		state.players.push_back({player[0] * header_.position_quantum,
+								 player[1] * header_.position_quantum,
+								 static_cast<uint32_t>(player[2]),
+								 static_cast<uint32_t>(player[3])});
+	}
+	state.balls.clear();
+	for(auto const& ball : decoded_.balls) {
+		state.balls.push_back({ball[0] * header_.position_quantum,
+							   ball[1] * header_.position_quantum,
+							   ball[2] * header_.angle_quantum});
+	}
+	state.obstacles = decoded_.obstacles;
+	state.nb_obstacles = 0;
+	for(Mask_Word word : state.obstacles)
+		state.nb_obstacles += __builtin_popcountll(word);
+	return true;
+}
+
+/**
+ * Only the flags and the step of each frame are read. The steps of a recording go
+ * up, the first frame is a keyframe.
+ */
+bool Trajectory_Replay::index_frames() {
+	const unsigned char* position(reinterpret_cast<const unsigned char*>(file_.data())
+								  + sizeof(header_));
+	const unsigned char* end(reinterpret_cast<const unsigned char*>(file_.end()));
+
+	uint32_t frame_size(0);
+	while(size_t(end - position) >= sizeof(frame_size)) {
+		std::memcpy(&frame_size, position, sizeof(frame_size));
+		position += sizeof(frame_size);
+		if(frame_size == 0 || frame_size > size_t(end - position)) break;
+
+		const unsigned char* frame(position + 1);
+		uint64_t step(0);
+		if(get_varint(frame, position + frame_size, step) == false ||
+		   (frames_.empty() == false && step < frames_.back().step))
+			break;
+
+		if(*position & Trajectory::KEYFRAME)
+			keyframes_.push_back(frames_.size());
+		frames_.push_back({position, frame_size, step});
+		position += frame_size;
+	}
+	return frames_.empty() == false && keyframes_.empty() == false && 
+		   keyframes_.front() == 0;
+}
+
+/**
+ * Decodes the frames from the keyframe before "index", or from the last frame decoded
+ * if it lies in between. The values are decoded over those of the previous frame,
+ * which are the references of its deltas.
+ */
+bool Trajectory_Replay::decode(size_t index) {
+	size_t first(*(std::upper_bound(keyframes_.begin(), keyframes_.end(), index) - 1));
+	if(decoded_index_ != no_frame && decoded_index_ >= first && 
+	   decoded_index_ <= index)
+		first = decoded_index_ + 1;
+
+	size_t nb_words(Snapshot::bitmap_words(header_.nb_cells));
+	for(size_t i(first); i <= index; ++i) {
+		decoded_index_ = no_frame;		//until the frame is complete
+		const unsigned char* frame(frames_[i].data);
+		const unsigned char* frame_end(frame + frames_[i].size);
+
+		uint8_t flags(*frame++);
+		uint64_t step(0), nb_players(0), nb_balls(0);
+		if(!get_varint(frame, frame_end, step) ||
+		   !get_varint(frame, frame_end, nb_players) ||
+		   !get_varint(frame, frame_end, nb_balls) ||
+		   !get_values(frame, frame_end, decoded_.players, nb_players,
+					   flags & Trajectory::PLAYER_DELTAS) ||
+		   !get_values(frame, frame_end, decoded_.balls, nb_balls,
+					   flags & Trajectory::BALL_DELTAS))
+			return false;
+
+		if(flags & Trajectory::HAS_OBSTACLES) {
+			if(size_t(frame_end - frame) < nb_words * sizeof(Mask_Word)) return false;
+			decoded_.obstacles.resize(nb_words);
+			std::memcpy(decoded_.obstacles.data(), frame, nb_words * sizeof(Mask_Word));
+		} else if(decoded_.obstacles.size() != nb_words) {
+			return false;
+		}
+		decoded_index_ = i;
+	}
+	return true;
+}
@@ -0,0 +1,211 @@
+/**
+ * file: trajectory.h
+ * 
+ * authors:	Cem Keske
+ * 			Emre Yazici
+ */
+#ifndef TRAJECTORY_H_INCLUDED
+#define TRAJECTORY_H_INCLUDED
+
+#include "simulation.h"
+#include "mapped_file.h"
+#include <string>
+#include <vector>
+#include <deque>
+#include <array>
+#include <fstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+
+/// TRAJECTORY FORMAT ///
+/**
+ * Recording of a game, one frame per step (".traj" files):
+ * 
+ *	Header
+ *	frames: uint32_t size of the frame in bytes, then the frame
+ * 
+ * A frame holds the data of a saved file (Saved_State) at the end of a step:
+ * 
+ *	uint8_t flags, varint step, varint nb_players, varint nb_balls
+ *	players: x, y, lives, cooldown		signed varints
+ *	balls: x, y, angle					signed varints
+ *	obstacle bitmap (Mask_Word)			only with HAS_OBSTACLES
+ * 
+ * Positions and angles are quantised (position_quantum, angle_quantum of the header).
+ * In a keyframe every value is absolute and the bitmap is given. In the other frames
+ * the players (PLAYER_DELTAS) and the balls (BALL_DELTAS) are given as differences
+ * with the previous frame when their number didn't change, and the bitmap only when
+ * it changed. A keyframe is written every keyframe_interval frames, so that a frame
+ * can be decoded from the keyframe before it.
+ */
+namespace Trajectory {
+
+	constexpr char magic[8] = {'D', 'O', 'D', 'G', 'E', 'T', 'R', 'J'};
+	constexpr uint32_t version = 1;
+	constexpr uint32_t keyframe_interval = 256;
+	constexpr double position_quantum = 1. / 1024;
+	constexpr double angle_quantum = 6.283185307179586 / 65536;
+
+	enum Frame_Flags : uint8_t {
+		KEYFRAME = 1,
+		PLAYER_DELTAS = 2,
+		BALL_DELTAS = 4,
+		HAS_OBSTACLES = 8
+	};
+
+	struct Header {
+		char magic[8];
+		uint32_t version;
+		uint32_t byte_order;
+		uint32_t nb_cells;
+		uint32_t keyframe_interval;
+		double position_quantum;
+		double angle_quantum;
+	};
+
+	static_assert(sizeof(Header) == 40, "trajectory header must not be padded");
+
+	/// quantised values of a frame, the references of the deltas of the next one
+	struct Quantised_Frame {
+		std::vector<std::array<int64_t, 4>> players;
+		std::vector<std::array<int64_t, 3>> balls;
+		std::vector<Mask_Word> obstacles;
+	};
+
+	bool is_trajectory_path(const std::string& file_path);
+}
+
+
+/// TRAJECTORY RECORDER ///
+/**
+ * Writes a trajectory file while a simulation runs. The simulation only copies its
+ * state into a frame (next_frame, commit), the frames are encoded and written by an
+ * I/O thread in batches. At most max_pending frames wait for the I/O thread, a step
+ * waits for it beyond that.
+ */
+class Trajectory_Recorder {
+
+	public:
+
+		struct Frame {
+			size_t step = 0;
+			Saved_State state;
+		};
+
+	private:
+
+		std::ofstream file_;
+		size_t nb_cells_;
+
+		std::vector<std::unique_ptr<Frame>> frames_;	//all frames, owned
+		std::vector<Frame*> free_frames_;
+		std::deque<Frame*> full_frames_;
+		Frame* current_;							//being filled by the simulation
+
+		std::mutex mutex_;
+		std::condition_variable frame_freed_;
+		std::condition_variable frame_committed_;
+		bool stop_;
+		std::thread io_thread_;
+
+		/// I/O thread only
+		std::vector<unsigned char> batch_;
+		Trajectory::Quantised_Frame previous_;
+		Trajectory::Quantised_Frame quantised_;
+		size_t nb_frames_;
+		bool failed_;
+
+	public:
+
+		// ===== Constructor / Destructor =====
+
+		Trajectory_Recorder(const std::string& file_path, size_t nb_cells);
+		~Trajectory_Recorder();
+
+		Trajectory_Recorder(const Trajectory_Recorder&) = delete;
+		Trajectory_Recorder& operator=(const Trajectory_Recorder&) = delete;
+
+		// ===== Methods =====
+
+		bool is_open() const;
+
+		/// frame for the simulation to fill, then to give back with commit()
+		Saved_State& next_frame();
+		void commit(size_t step);
+
+		/// writes the frames left, false if a write failed
+		bool close();
+		size_t nb_frames() const;	//valid after close()
+
+	private:
+
+		void run_io_thread();
+		void encode(Frame const&);
+		void flush_batch();
+};
+
+
+/// TRAJECTORY REPLAY ///
+/**
+ * Random access to the frames of a trajectory file, from a mapping of the file.
+ * 
+ * Opening it only walks the size prefixes of the frames to index their offsets, steps
+ * and keyframes. A frame is then decoded from the keyframe before it, so reaching any
+ * step decodes at most keyframe_interval frames. Going forward from the last frame 
+ * decoded continues from it instead, playing a recording in order decodes each frame 
+ * once. A file cut in the middle of a frame (recording interrupted) is indexed up to 
+ * its last complete frame.
+ */
+class Trajectory_Replay {
+	
+	private:
+		
+		struct Frame_Entry {
+			const unsigned char* data;	//after the size prefix
+			uint32_t size;
+			size_t step;
+		};
+		
+		Mapped_File file_;
+		Trajectory::Header header_;
+		bool valid_;
+		
+		std::vector<Frame_Entry> frames_;
+		std::vector<size_t> keyframes_;		//indices in frames_
+		
+		Trajectory::Quantised_Frame decoded_;
+		size_t decoded_index_;				//frame held by decoded_ (if any)
+	
+	public:
+		
+		// ===== Constructor =====
+		
+		explicit Trajectory_Replay(const std::string& file_path);
+		
+		// ===== Methods =====
+		
+		bool is_valid() const;		//a trajectory file of this version, with frames
+		size_t nb_cells() const;
+		size_t nb_frames() const;
+		size_t first_step() const;
+		size_t last_step() const;
+		size_t frame_step(size_t index) const;
+		
+		/// index of the last frame at or before "step" (the first one before the start)
+		size_t frame_index(size_t step) const;
+		
+		/// decodes a frame, false on a bad frame
+		bool frame(size_t index, Saved_State&);
+		bool seek(size_t step, Saved_State&);	//frame at frame_index(step)
+	
+	private:
+		
+		bool index_frames();
+		bool decode(size_t index);
+};
+
+#endif
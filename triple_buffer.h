@@ -0,0 +1,67 @@
+/**
+ * file: triple_buffer.h
+ *
+ * authors:	Cem Keske
+ * 			Emre Yazici
+ */
+#ifndef TRIPLE_BUFFER_H_INCLUDED
+#define TRIPLE_BUFFER_H_INCLUDED
+
+#include <atomic>
+
+/// TRIPLE BUFFER ///
+/**
+ * Hands values from one writer thread to one reader thread without locks.
+ *
+ * The writer fills back() and calls publish(), the reader takes the latest published
+ * value with front(). The three slots are: the one being written, the one being read
+ * and the last published one in between. Both sides only exchange their own slot
+ * with the middle one, so neither ever waits for the other; values published between
+ * two reads are skipped.
+ */
+template <typename T>
+class Triple_Buffer {
+
+	private:
+
+		static constexpr unsigned index_mask = 3;
+		static constexpr unsigned fresh_bit = 4;	//middle slot not read yet
+
+		T slots_[3];
+		std::atomic<unsigned> middle_;
+		unsigned back_;		//writer only
+		unsigned front_;	//reader only
+
+	public:
+
+		// ===== Constructor =====
+
+		Triple_Buffer() : middle_(1), back_(0), front_(2) {}
+
+		Triple_Buffer(const Triple_Buffer&) = delete;
+		Triple_Buffer& operator=(const Triple_Buffer&) = delete;
+
+		// ===== Writer =====
+
+		/// slot to fill, holds the value published two publish() before
+		T& back() {return slots_[back_];}
+
+		void publish() {
+			unsigned previous(middle_.exchange(back_ | fresh_bit,
+											   std::memory_order_acq_rel));
+			back_ = previous & index_mask;
+		}
+
+		// ===== Reader =====
+
+		/// latest published value, valid until the next call
+		const T& front() {
+			if(middle_.load(std::memory_order_relaxed) & fresh_bit) {
+				unsigned previous(middle_.exchange(front_, std::memory_order_acq_rel));
+				front_ = previous & index_mask;
+			}
+			return slots_[front_];
+		}
+};
+
+#endif